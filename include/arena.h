@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define ARENA_BLOCK_SIZE (1ul << 20)
+#define ARENA_ALIGN 8
+
+#define ARENA_INIT_LIST     \
+    {                       \
+        .head = NULL,       \
+        .stats = {          \
+            .allocs = 0,    \
+            .blocks = 0,    \
+            .bytes = 0      \
+        }                   \
+    }
+
+// NOTE block data follows the header, which is padded
+// so that the data starts aligned to ARENA_ALIGN
+typedef struct alignas(ARENA_ALIGN) arena_block_t
+{
+    arena_block_t* next;
+    size_t capacity;
+    size_t used;
+} arena_block_t;
+
+typedef struct arena_stats_t
+{
+    size_t allocs;
+    size_t blocks;
+    size_t bytes;
+} arena_stats_t;
+
+// Bump allocator over a list of big zeroed blocks. Memory is never
+// freed piece by piece, arena_free releases all blocks at once
+typedef struct arena_t
+{
+    // block allocations are made from, the rest are full
+    arena_block_t* head;
+
+    arena_stats_t stats;
+} arena_t;
+
+// Starts a new block, returns NULL if it cannot be allocated
+void* arena_alloc_slow(arena_t* arena, size_t size);
+
+// Returns zeroed memory aligned to ARENA_ALIGN or NULL
+static inline void* arena_alloc(arena_t* arena, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    arena_block_t* block = arena->head;
+
+    if(!block || block->capacity - block->used < size)
+        return arena_alloc_slow(arena, size);
+
+    void* ptr = (char*)(block + 1) + block->used;
+
+    block->used += size;
+
+    arena->stats.allocs++;
+    arena->stats.bytes += size;
+
+    return ptr;
+}
+
+// Null-terminated copy of the first len chars of str
+char* arena_strndup(arena_t* arena, const char* str, size_t len);
+
+// Moves all blocks of src into dst, src is left empty
+void arena_merge(arena_t* dst, arena_t* src);
+
+void arena_free(arena_t* arena);
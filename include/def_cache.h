@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define DEF_CACHE_INIT_CAPACITY 64
+
+#define DEF_CACHE_INIT_LIST \
+    {                       \
+        .table = NULL,      \
+        .table_size = 0,    \
+        .newest = NULL,     \
+        .oldest = NULL,     \
+        .size = 0,          \
+        .bytes = 0,         \
+        .budget = 0,        \
+        .stats = {          \
+            .hits = 0,      \
+            .misses = 0,    \
+            .evicted = 0    \
+        }                   \
+    }
+
+typedef struct def_cache_stats_t
+{
+    size_t hits;
+    size_t misses;
+    size_t evicted;
+} def_cache_stats_t;
+
+// NOTE the text follows the entry and is null-terminated
+typedef struct def_cache_entry_t
+{
+    const void* key;
+    size_t len;
+
+    // next entry of the same slot
+    def_cache_entry_t* next;
+
+    // neighbours in the order of use, the newest first
+    def_cache_entry_t* newer;
+    def_cache_entry_t* older;
+} def_cache_entry_t;
+
+// Texts by the address they were rendered for, the least recently
+// used ones are evicted once entries and texts take more than budget
+// bytes. A cache with no budget keeps nothing
+typedef struct def_cache_t
+{
+    // chained hash of the key -> entry
+    def_cache_entry_t** table;
+    size_t table_size;
+
+    def_cache_entry_t* newest;
+    def_cache_entry_t* oldest;
+    size_t size;
+
+    size_t bytes;
+    size_t budget;
+
+    def_cache_stats_t stats;
+} def_cache_t;
+
+// Evicts entries until the cache fits the new budget
+void def_cache_set_budget(def_cache_t* cache, size_t budget);
+
+// Drops every entry and releases the table, the budget and the stats stay
+void def_cache_clear(def_cache_t* cache);
+
+// Returns the text cached for key and makes it the newest one, NULL if there
+// is none or the cache has no budget. The text is valid until the cache changes
+const char* def_cache_get(def_cache_t* cache, const void* key, size_t* len);
+
+// Copies the text in, replacing the one cached for key. Returns 0 if the
+// text is larger than the budget or cannot be allocated, nothing is cached then
+int def_cache_put(def_cache_t* cache, const void* key, const char* text, size_t len);
+
+void def_cache_remove(def_cache_t* cache, const void* key);
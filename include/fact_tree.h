@@ -4,6 +4,9 @@
 
 #include "stringutils.h"
 #include "stack.h"
+#include "arena.h"
+#include "str_pool.h"
+#include "def_cache.h"
 
 #define FACT_TREE_INIT_LIST \
     {                       \
@@ -13,7 +16,33 @@
             .ptr = NULL,    \
             .len = 0,       \
             .pos = 0        \
-        }                   \
+        },                  \
+        .lazy = {           \
+            .mode = FACT_TREE_LAZY_NONE, \
+            .fname = NULL,  \
+            .begin = NULL,  \
+            .end = NULL,    \
+            .size = 0,      \
+            .store = NULL   \
+        },                  \
+        .journal = {        \
+            .log = NULL,    \
+            .db_fname = NULL, \
+            .db_bin = 0     \
+        },                  \
+        .arena = ARENA_INIT_LIST, \
+        .names = STR_POOL_INIT_LIST, \
+        .soa = NULL,        \
+        .index = NULL,      \
+        .attrs = NULL,      \
+        .defs = DEF_CACHE_INIT_LIST, \
+        .shared = {         \
+            .gen = NULL,    \
+            .seen = 0,      \
+            .unsaved = 0    \
+        },                  \
+        .layout = FACT_TREE_LAYOUT_NONE, \
+        .pages_pool = 0     \
     };                      
 
 typedef enum fact_tree_err_t
@@ -23,16 +52,86 @@ typedef enum fact_tree_err_t
     FACT_TREE_NULLPTR,
     FACT_TREE_ALLOC_FAIL,
     FACT_TREE_IO_ERR,
-    FACT_TREE_SYNTAX_ERR
+    FACT_TREE_SYNTAX_ERR,
+    FACT_TREE_FORMAT_ERR,
+    FACT_TREE_EMBED_ERR,
+    FACT_TREE_LAZY_ERR,
+    FACT_TREE_UNSAVED_ERR
 } fact_tree_err_t;
 
+typedef enum fact_tree_lazy_mode_t
+{
+    FACT_TREE_LAZY_NONE,
+    FACT_TREE_LAZY_TEXT,
+    FACT_TREE_LAZY_BIN,
+    FACT_TREE_LAZY_PAGED
+} fact_tree_lazy_mode_t;
+
+#define FACT_TREE_NAME_INLINE 16
+
+// Order nodes are kept in memory and in binary databases.
+// Lookups walk from the root down, BFS and van Emde Boas orders
+// keep the top levels of the tree in few cache lines
+typedef enum fact_tree_layout_t
+{
+    FACT_TREE_LAYOUT_NONE,
+    FACT_TREE_LAYOUT_BFS,
+    FACT_TREE_LAYOUT_VEB
+} fact_tree_layout_t;
+
+typedef struct page_store_t page_store_t;
+
+typedef struct journal_t journal_t;
+
+typedef struct fact_tree_soa_t fact_tree_soa_t;
+
+typedef struct fact_tree_index_t fact_tree_index_t;
+
+typedef struct fact_tree_attrs_t fact_tree_attrs_t;
+
+typedef struct fact_tree_attr_t fact_tree_attr_t;
+
+typedef struct fact_tree_query_t fact_tree_query_t;
+
+typedef struct generation_t generation_t;
+
 typedef struct fact_tree_node_t
 {
-    utils_str_t name;
+    // NOTE names of up to FACT_TREE_NAME_INLINE bytes are stored in the
+    // node itself, so reading them costs no extra cache miss. A longer
+    // name is a slice and is not null-terminated: it points either into
+    // the mapped database file or into the arena of the tree.
+    // Use fact_tree_node_name instead of reading them directly.
+    // name_id is its id in the string pool of the tree. Names copied
+    // into the arena get it right away, mapped ones when the name index
+    // is built, loads leave them out of the pool
+    union {
+        char* str;
+        char buf[FACT_TREE_NAME_INLINE];
+    } name;
+    size_t name_len;
+    uint32_t name_id;
+
+    // NOTE depth and jump are linked as soon as a node is built: by loads,
+    // lazy expansions and inserts, and again when relayout moves nodes,
+    // so ancestor lookups only read them. jump is an ancestor at most twice
+    // as far as the one before it, so any ancestor is O(log depth) jumps away
+    uint32_t depth;
+
+    // NOTE if lazy is set, left and right are not built yet: lazy_id
+    // is the node's number in the subtree index or its binary record.
+    // Nodes of a paged database keep their cell number in lazy_id.
+    // Use fact_tree_node_left/right instead of reading them directly.
+    // A node whose children cannot be read from the file stays lazy
+    int lazy;
+    size_t lazy_id;
+
     fact_tree_node_t* left;
     fact_tree_node_t* right;
     fact_tree_node_t* parent;
 
+    const fact_tree_node_t* jump;
+
 } fact_tree_node_t;
 
 typedef struct fact_tree_t
@@ -40,20 +139,110 @@ typedef struct fact_tree_t
     fact_tree_node_t* root;
     size_t size;
 
+    // read-only mapping of the database file
     struct {
         char* ptr;
         ssize_t len;
         ssize_t pos;
     } buf;
 
+    // subtree index of a lazily loaded text database:
+    // span [begin, end) of every node in preorder,
+    // or the buffer pool of a paged database
+    struct {
+        fact_tree_lazy_mode_t mode;
+        char* fname;
+        size_t* begin;
+        size_t* end;
+        size_t size;
+        page_store_t* store;
+    } lazy;
+
+    // append-only log of inserts made since the database
+    // file was last written, replayed on load
+    struct {
+        journal_t* log;
+        char* db_fname;
+        int db_bin;
+    } journal;
+
+    // nodes and the names they do not map are allocated here
+    // and released together by fact_tree_dtor
+    arena_t arena;
+
+    // interned names, equal names share one id and one copy
+    str_pool_t names;
+
+    // index-based copy of an eagerly loaded tree for lookups,
+    // built on the first one and dropped when the tree changes
+    fact_tree_soa_t* soa;
+
+    // leaves by name, built from the copy on the first lookup,
+    // kept up to date by inserts and dropped when nodes move
+    fact_tree_index_t* index;
+
+    // leaf ranges of the questions by name for attribute
+    // queries, built from the copy and dropped with it
+    fact_tree_attrs_t* attrs;
+
+    // rendered definitions by leaf, off until given a budget.
+    // An insert drops the leaf it turns into a question,
+    // loads and relayouts drop them all
+    def_cache_t defs;
+
+    // version counter of a database shared with other processes,
+    // the file is mapped again once a writer publishes a new one.
+    // unsaved counts inserts not written to any file since the
+    // load, a newer version is not mapped while there are some
+    struct {
+        generation_t* gen;
+        uint64_t seen;
+        size_t unsaved;
+    } shared;
+
+    // nodes of an eagerly loaded tree are reordered in memory
+    // after loads and compactions, binary files are written this way
+    fact_tree_layout_t layout;
+
+    // memory cap of the buffer pool paged databases are opened
+    // with by fact_tree_fread, 0 keeps the default one
+    size_t pages_pool;
+
 } fact_tree_t;
 
+// nodes from a leaf up to the root, paths of most trees fit inline
+#define FACT_TREE_PATH_INLINE 64
+
+typedef stk_t<const fact_tree_node_t*, FACT_TREE_PATH_INLINE> fact_tree_path_t;
+
 fact_tree_err_t fact_tree_ctor(fact_tree_t* fact_tree);
 
 void fact_tree_dtor(fact_tree_t* fact_tree);
 
 fact_tree_err_t fact_tree_insert(fact_tree_t* fact_tree, fact_tree_node_t* node, fact_tree_node_t** ret);
 
+// Turns the leaf into question with the old leaf on the left and
+// the new object on the right. Names are copied, the insert is journaled.
+// A full journal is written into the database file, but no node is
+// moved, so node and *ret stay valid
+fact_tree_err_t fact_tree_insert_object(
+    fact_tree_t* fact_tree, 
+    fact_tree_node_t* node, 
+    const char* name, 
+    size_t name_len,
+    const char* question, 
+    size_t question_len,
+    fact_tree_node_t** ret);
+
+// Rewrites the database file with all journaled inserts and empties the journal,
+// then relays the tree out like fact_tree_relayout
+fact_tree_err_t fact_tree_compact(fact_tree_t* fact_tree);
+
+// Moves nodes of an eagerly loaded tree between the places they occupy,
+// so that they follow each other in layout order. Node pointers held
+// outside of the tree are invalidated. Lazy trees are left as they are
+fact_tree_err_t fact_tree_relayout(fact_tree_t* fact_tree, fact_tree_layout_t layout);
+
 fact_tree_node_t* fact_tree_guess(fact_tree_t* fact_tree);
 
 const char* fact_tree_strerr(fact_tree_err_t err);
@@ -62,9 +251,72 @@ fact_tree_err_t fact_tree_fwrite(fact_tree_t* fact_tree, const char* filename);
 
 fact_tree_err_t fact_tree_fread(fact_tree_t* fact_tree, const char* filename);
 
-const fact_tree_node_t* fact_tree_find_object(const fact_tree_node_t* node, const char* name);
+fact_tree_err_t fact_tree_fread_lazy(fact_tree_t* fact_tree, const char* filename);
+
+// Maps a binary database that other processes map as well: records are
+// position-independent, so nodes are built from the shared pages on
+// demand. No journal is kept, inserts are lost unless saved to a file.
+// On error the tree is left as it was
+fact_tree_err_t fact_tree_fread_shared(fact_tree_t* fact_tree, const char* filename);
+
+// Atomically replaces the binary database and lets the
+// processes sharing it know there is a new version
+fact_tree_err_t fact_tree_publish(fact_tree_t* fact_tree, const char* filename);
+
+// Maps a shared database again if a newer version was published.
+// Node pointers held outside of the tree are invalidated then. The tree
+// is kept as it is if the new version cannot be mapped, and while it
+// has unsaved inserts, which is reported with FACT_TREE_UNSAVED_ERR
+fact_tree_err_t fact_tree_refresh(fact_tree_t* fact_tree);
+
+// Opens a database written by fact_tree_fwrite_pages. Nodes are read
+// through a buffer pool of at most pool_size bytes as they are expanded,
+// inserts are written into the file in place
+fact_tree_err_t fact_tree_fread_pages(fact_tree_t* fact_tree, const char* filename, size_t pool_size);
+
+fact_tree_err_t fact_tree_fwrite_pages(fact_tree_t* fact_tree, const char* filename);
+
+// Builds the children of a lazy node. If the file is broken there, the
+// node stays lazy with no children and every later call tries again
+fact_tree_err_t fact_tree_expand(fact_tree_t* fact_tree, fact_tree_node_t* node);
+
+static inline const char* fact_tree_node_name(const fact_tree_node_t* node)
+{
+    return node->name_len <= FACT_TREE_NAME_INLINE ? node->name.buf : node->name.str;
+}
 
-fact_tree_err_t fact_tree_get_object_path(fact_tree_t* ftree, const fact_tree_node_t* node, stk_t* stk);
+// New node named by an interned copy of str, allocated in the arena of the tree
+fact_tree_err_t fact_tree_copy_name(fact_tree_t* fact_tree, const char* str, size_t len, fact_tree_node_t** node);
+
+// Returns the string pool id of the node's name, interning it if needed
+uint32_t fact_tree_node_name_id(fact_tree_t* fact_tree, fact_tree_node_t* node);
+
+// Children of the node, expanded first if it is lazy. Both are NULL for
+// a node that cannot be expanded, which is told from a leaf by lazy
+fact_tree_node_t* fact_tree_node_left(fact_tree_t* fact_tree, fact_tree_node_t* node);
+
+fact_tree_node_t* fact_tree_node_right(fact_tree_t* fact_tree, fact_tree_node_t* node);
+
+fact_tree_err_t fact_tree_fwrite_bin(fact_tree_t* fact_tree, const char* filename);
+
+const fact_tree_node_t* fact_tree_find_object(fact_tree_t* ftree, fact_tree_node_t* node, const char* name);
+
+// Puts the first max leaves named exactly name into found in preorder
+// and how many there are into count. Eagerly loaded trees are looked up
+// in the index, others are walked. Paged databases give FACT_TREE_LAZY_ERR
+fact_tree_err_t fact_tree_find_objects(fact_tree_t* ftree, const char* name, const fact_tree_node_t** found, size_t max, size_t* count);
+
+// Starts a query for the objects that have all of the attributes, read
+// them with fact_tree_query_next and finish with fact_tree_query_end.
+// Only eagerly loaded trees are numbered, lazy ones give FACT_TREE_LAZY_ERR
+fact_tree_err_t fact_tree_query(fact_tree_t* ftree, fact_tree_query_t* query, const fact_tree_attr_t* attrs, size_t size);
+
+// Pushes node and its ancestors, the root ends up on top.
+// The path is constructed here and must be destructed by the caller
+fact_tree_err_t fact_tree_get_object_path(fact_tree_t* ftree, const fact_tree_node_t* node, fact_tree_path_t* path);
+
+// Deepest node both a and b descend from, either of them included
+const fact_tree_node_t* fact_tree_common_ancestor(const fact_tree_node_t* node_a, const fact_tree_node_t* node_b);
 
 fact_tree_err_t fact_tree_print_definition(fact_tree_t* ftree, const fact_tree_node_t* node);
 
@@ -73,6 +325,8 @@ fact_tree_err_t fact_tree_print_difference(fact_tree_t* ftree, const fact_tree_n
 void printf_and_say(const char* fmt, ...)
     __attribute__ ((format (printf, 1, 2)));
 
+#ifdef _DEBUG
+
 void fact_tree_dump(fact_tree_t* fact_tree, fact_tree_err_t err, const char* msg, const char* file, int line, const char* funcname);
 
 #define FACT_TREE_DUMP(fact_tree, err) \
@@ -80,3 +334,11 @@ void fact_tree_dump(fact_tree_t* fact_tree, fact_tree_err_t err, const char* msg
 
 #define FACT_TREE_DUMP_MSG(fact_tree, err, msg) \
     fact_tree_dump(fact_tree, err, msg, __FILE__, __LINE__, __func__); 
+
+#else // _DEBUG
+
+#define FACT_TREE_DUMP(fact_tree, err) 
+
+#define FACT_TREE_DUMP_MSG(fact_tree, err, msg) 
+
+#endif // _DEBUG
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+// Binary database layout, native byte order:
+//
+//   fact_tree_bin_header_t
+//   fact_tree_bin_node_t   nodes[node_count]
+//   char                   strtab[strtab_size]
+//
+// Node 0 is the root. Every child has a greater index than its parent,
+// so a single forward pass over the records is enough to validate the
+// file and link the tree. Names are not null-terminated.
+
+#define FACT_TREE_BIN_MAGIC   "EXYSTBIN"
+#define FACT_TREE_BIN_VERSION 1u
+#define FACT_TREE_BIN_NIL     UINT32_MAX
+
+typedef struct fact_tree_bin_header_t
+{
+    char     magic[sizeof(FACT_TREE_BIN_MAGIC) - 1];
+    uint32_t version;
+    uint32_t node_count;
+    uint64_t strtab_size;
+} fact_tree_bin_header_t;
+
+typedef struct fact_tree_bin_node_t
+{
+    uint32_t left;
+    uint32_t right;
+    uint32_t parent;
+    uint32_t name_len;
+    uint64_t name_off;
+} fact_tree_bin_node_t;
+
+static_assert(sizeof(fact_tree_bin_header_t) == 24, "binary header layout changed");
+static_assert(sizeof(fact_tree_bin_node_t)   == 24, "binary node layout changed");
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdlib.h>
+
+#include "fact_tree.h"
+
+// Tree compiled into the executable. The generated source defines its
+// nodes as a static array linked by address and its long names as a
+// constexpr string table, so nothing is read or allocated to load it.
+// Build with make EMBED_DB=<database> to link one in
+typedef struct fact_tree_embed_t
+{
+    fact_tree_node_t* nodes;
+    size_t size;
+
+    // database the source was generated from
+    const char* source;
+} fact_tree_embed_t;
+
+// NOTE defined only by the generated source, NULL in other builds
+extern const fact_tree_embed_t fact_tree_embedded __attribute__((weak));
+
+static inline int fact_tree_has_embedded()
+{
+    return &fact_tree_embedded != NULL;
+}
+
+// Makes the embedded nodes the tree. They are changed in place by inserts,
+// so the embedded tree can only be taken once per process
+fact_tree_err_t fact_tree_fread_embedded(fact_tree_t* fact_tree);
+
+// Writes C++ source defining the tree as fact_tree_embedded
+fact_tree_err_t fact_tree_fwrite_cpp(fact_tree_t* fact_tree, const char* filename);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "fact_tree.h"
+#include "fact_tree_soa.h"
+
+#define FACT_TREE_INDEX_NIL UINT32_MAX
+
+// Leaves of an eagerly loaded tree by the ids of their names. A name is
+// hashed once by the string pool, its id then picks the leaves directly.
+// Leaves are entered in preorder, equal names are chained from the last
+// leaf back to the first one
+typedef struct fact_tree_index_t
+{
+    // name id -> last entry of the name
+    uint32_t* heads;
+    size_t heads_size;
+
+    // entry -> leaf and the entry before it with the same name
+    fact_tree_node_t** leaves;
+    uint32_t* prev;
+    size_t size;
+    size_t capacity;
+} fact_tree_index_t;
+
+// Enters the leaves of the copy, names_size is the size of
+// the string pool every name of the copy is interned in
+fact_tree_err_t fact_tree_index_build(fact_tree_index_t* index, const fact_tree_soa_t* soa, size_t names_size);
+
+void fact_tree_index_dtor(fact_tree_index_t* index);
+
+// Enters a leaf after every other one, the same as the last leaf in preorder
+fact_tree_err_t fact_tree_index_add(fact_tree_index_t* index, fact_tree_node_t* leaf);
+
+// Puts node in place of leaf, node must hold the name leaf
+// was entered under. Returns 0 if leaf is not in the index
+int fact_tree_index_replace(fact_tree_index_t* index, const fact_tree_node_t* leaf, fact_tree_node_t* node);
+
+// Returns the last entry of the name, FACT_TREE_INDEX_NIL if no leaf has it
+static inline uint32_t fact_tree_index_last(const fact_tree_index_t* index, uint32_t name_id)
+{
+    return name_id < index->heads_size ? index->heads[name_id] : FACT_TREE_INDEX_NIL;
+}
+
+// Returns the entry before this one with the same name or FACT_TREE_INDEX_NIL
+static inline uint32_t fact_tree_index_prev(const fact_tree_index_t* index, uint32_t entry)
+{
+    return index->prev[entry];
+}
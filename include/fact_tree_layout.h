@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "fact_tree.h"
+#include "fact_tree_soa.h"
+
+// Numbers the nodes of the tree in layout order: order[i] is the i-th
+// node, links[i] holds the numbers of its children and its parent.
+// Parents always come before their children. Lazy parts of the tree
+// are built on the way
+fact_tree_err_t fact_tree_layout_order(
+    fact_tree_t* ftree,
+    fact_tree_layout_t layout,
+    fact_tree_node_t*** order,
+    fact_tree_soa_link_t** links,
+    size_t* size);
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "page_store.h"
+#include "fact_tree.h"
+
+// Paged database layout, native byte order. The file is a sequence
+// of PAGE_STORE_PAGE_SIZE pages split into 32-byte cells:
+//
+//   page 0       fact_tree_pages_header_t in cell 0
+//   node pages   fact_tree_page_header_t, fact_tree_page_node_t cells
+//   name pages   fact_tree_page_header_t, name bytes in whole cells
+//
+// Nodes are referred to by global cell number: page * cells per page
+// + cell. A name fills consecutive cells of a single name page, so
+// it is read with one page access. Node and name pages interleave as
+// they fill up, inserts append cells to the last page of each kind.
+
+#define FACT_TREE_PAGES_MAGIC   "EXYSTPGS"
+#define FACT_TREE_PAGES_VERSION 1u
+#define FACT_TREE_PAGES_NIL     UINT32_MAX
+
+#define FACT_TREE_PAGES_CELL_SIZE      32
+#define FACT_TREE_PAGES_CELLS_PER_PAGE (PAGE_STORE_PAGE_SIZE / FACT_TREE_PAGES_CELL_SIZE)
+#define FACT_TREE_PAGES_NAME_MAX       ((FACT_TREE_PAGES_CELLS_PER_PAGE - 1) * FACT_TREE_PAGES_CELL_SIZE)
+
+// buffer pool cap when the tree does not set pages_pool
+#define FACT_TREE_PAGES_POOL_DEFAULT (64ul << 20)
+
+typedef enum fact_tree_page_kind_t
+{
+    FACT_TREE_PAGE_NODES = 1,
+    FACT_TREE_PAGE_NAMES = 2
+} fact_tree_page_kind_t;
+
+typedef struct fact_tree_pages_header_t
+{
+    char     magic[sizeof(FACT_TREE_PAGES_MAGIC) - 1];
+    uint32_t version;
+    uint32_t root;
+    uint64_t node_count;
+    uint32_t nodes_page;
+    uint32_t names_page;
+} fact_tree_pages_header_t;
+
+// cell 0 of every node and name page
+typedef struct fact_tree_page_header_t
+{
+    uint32_t kind;
+    uint32_t cells_used;
+    uint8_t  reserved[24];
+} fact_tree_page_header_t;
+
+typedef struct fact_tree_page_node_t
+{
+    uint32_t left;
+    uint32_t right;
+    uint32_t parent;
+    uint32_t name_len;
+    uint32_t name_cell;
+    uint8_t  reserved[12];
+} fact_tree_page_node_t;
+
+static_assert(sizeof(fact_tree_pages_header_t) == 32, "paged header layout changed");
+static_assert(sizeof(fact_tree_page_header_t)  == 32, "page header layout changed");
+static_assert(sizeof(fact_tree_page_node_t)    == 32, "paged node layout changed");
+
+// Tells a paged database by the first bytes of its file
+int fact_tree_pages_magic(const char* magic);
+
+// Builds the children of a lazy node of a paged database
+fact_tree_err_t fact_tree_pages_expand(fact_tree_t* fact_tree, fact_tree_node_t* node);
+
+// Flushes and closes the buffer pool, logging its hit rate
+void fact_tree_pages_close(fact_tree_t* fact_tree);
+
+// Writes the node itself and the two new leaves of fact_tree_insert. It runs
+// before the leaf becomes a question in memory: node still has its own name,
+// which moves with its cells to the new leaf question is swapped into.
+// Nothing points at the new cells until they are on disk, then the node is
+// linked to them and only then are they counted in the header, so a crash
+// in between leaves unreachable cells and never a link to a missing one
+fact_tree_err_t fact_tree_pages_insert(fact_tree_t* fact_tree, const fact_tree_node_t* node, fact_tree_node_t* question, fact_tree_node_t* added);
+
+// Scans node pages for a leaf named name and builds only the path
+// from the root down to it. The first match in page order is returned
+fact_tree_node_t* fact_tree_pages_find(fact_tree_t* fact_tree, const char* name);
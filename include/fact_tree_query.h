@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "fact_tree.h"
+#include "fact_tree_soa.h"
+
+// Leaves [first, last) in preorder
+typedef struct fact_tree_attrs_range_t
+{
+    uint32_t first;
+    uint32_t last;
+} fact_tree_attrs_range_t;
+
+// The leaves on the "no" (left) and "yes" (right) side of a question
+typedef struct fact_tree_attrs_question_t
+{
+    fact_tree_attrs_range_t no;
+    fact_tree_attrs_range_t yes;
+} fact_tree_attrs_question_t;
+
+// Questions of an eagerly loaded tree by the ids of their names. Leaves
+// are numbered in preorder, so the leaves of any subtree take one range
+// of numbers and the objects that have an attribute are a few ranges
+typedef struct fact_tree_attrs_t
+{
+    // leaf number -> leaf
+    fact_tree_node_t** leaves;
+    size_t leaves_size;
+
+    // name id -> questions [offsets[id], offsets[id + 1]) asked with it
+    uint32_t* offsets;
+    size_t names_size;
+
+    fact_tree_attrs_question_t* questions;
+    size_t questions_size;
+} fact_tree_attrs_t;
+
+// One attribute of a query: the text of a question and the answer
+typedef struct fact_tree_attr_t
+{
+    const char* question;
+    size_t question_len;
+    int yes;
+} fact_tree_attr_t;
+
+// Leaves left after intersecting the ranges of every attribute, read
+// one at a time with fact_tree_query_next.
+// NOTE the query reads the attribute index of the tree, it must be
+// finished before the tree is changed
+typedef struct fact_tree_query_t
+{
+    const fact_tree_attrs_t* attrs;
+
+    // sorted disjoint ranges matching so far
+    fact_tree_attrs_range_t* ranges;
+    size_t size;
+    size_t capacity;
+
+    // ranges of the attribute being added and their intersection
+    fact_tree_attrs_range_t* found;
+    size_t found_capacity;
+    fact_tree_attrs_range_t* next;
+    size_t next_capacity;
+
+    // position of the cursor
+    size_t range;
+    uint32_t leaf;
+} fact_tree_query_t;
+
+// Numbers the leaves of the copy, names_size is the size of
+// the string pool every name of the copy is interned in
+fact_tree_err_t fact_tree_attrs_build(fact_tree_attrs_t* attrs, const fact_tree_soa_t* soa, size_t names_size);
+
+void fact_tree_attrs_dtor(fact_tree_attrs_t* attrs);
+
+// Starts a query matching every leaf
+fact_tree_err_t fact_tree_query_start(fact_tree_query_t* query, const fact_tree_attrs_t* attrs);
+
+// Keeps the leaves on the given side of some question with the name. An
+// object on neither side of any such question is not known to have the
+// attribute or not to have it, it is dropped either way
+fact_tree_err_t fact_tree_query_and(fact_tree_query_t* query, uint32_t name_id, int yes);
+
+// Returns the next matching leaf in preorder, NULL once there are no more
+const fact_tree_node_t* fact_tree_query_next(fact_tree_query_t* query);
+
+// Number of matching leaves, those already read included
+size_t fact_tree_query_count(const fact_tree_query_t* query);
+
+void fact_tree_query_end(fact_tree_query_t* query);
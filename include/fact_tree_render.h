@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdlib.h>
+
+#include "fact_tree.h"
+
+// One answer on the way down to an object: the question asked and
+// whether the object is on its right, "yes", side or its left one
+typedef struct fact_tree_clause_t
+{
+    const fact_tree_node_t* question;
+    int yes;
+} fact_tree_clause_t;
+
+// Puts the answers leading from top down to node into clauses, the one
+// asked first first, and returns how many there are. Only the first max
+// of them are stored. A NULL top starts at the root.
+// NOTE renderers read nodes only, they never allocate, print or speak,
+// so any number of them may run at once on a tree nobody is changing
+size_t fact_tree_clauses(const fact_tree_node_t* node, const fact_tree_node_t* top, fact_tree_clause_t* clauses, size_t max);
+
+// Writes "<object> <answer>, not <answer>, ..." into buf. Like snprintf,
+// at most size bytes are written and the text is null-terminated if size
+// is not 0. Returns the length of the whole text, it did not fit if that
+// is size or more
+size_t fact_tree_render_definition(const fact_tree_node_t* node, char* buf, size_t size);
+
+// Writes "<a> and <b> both: <answers>, but <a> <answers>, and <b> <answers>."
+// the way fact_tree_render_definition does. The split point of the two
+// paths is found with fact_tree_common_ancestor over the jumps linked
+// when the nodes were built
+size_t fact_tree_render_difference(const fact_tree_node_t* node_a, const fact_tree_node_t* node_b, char* buf, size_t size);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "fact_tree.h"
+
+#define FACT_TREE_SOA_NIL UINT32_MAX
+
+typedef struct fact_tree_soa_link_t
+{
+    uint32_t left;
+    uint32_t right;
+    uint32_t parent;
+} fact_tree_soa_link_t;
+
+// Index-based copy of an eagerly loaded tree, nodes are numbered in
+// preorder. Traversals only read the dense links array, the cold arrays
+// are read once a traversal stops at a node
+typedef struct fact_tree_soa_t
+{
+    fact_tree_soa_link_t* links;
+
+    uint32_t* name_ids;
+    fact_tree_node_t** nodes;
+
+    size_t size;
+} fact_tree_soa_t;
+
+// Every name of the tree gets interned on the way
+fact_tree_err_t fact_tree_soa_build(fact_tree_t* ftree, fact_tree_soa_t* soa);
+
+void fact_tree_soa_dtor(fact_tree_soa_t* soa);
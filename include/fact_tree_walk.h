@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdlib.h>
+
+#include "fact_tree.h"
+#include "stack.h"
+
+// frames kept in the walk itself, deeper trees move them to the heap
+#define FACT_TREE_WALK_INLINE_FRAMES 64
+
+typedef enum fact_tree_walk_event_t
+{
+    FACT_TREE_WALK_PRE  = 1 << 0,   // before the children of the node
+    FACT_TREE_WALK_IN   = 1 << 1,   // between the left and the right child
+    FACT_TREE_WALK_POST = 1 << 2,   // after both children
+
+    // a node without children, asked for it is the only
+    // event of such nodes instead of the three above
+    FACT_TREE_WALK_LEAF = 1 << 3
+} fact_tree_walk_event_t;
+
+typedef enum fact_tree_walk_flag_t
+{
+    // lazy nodes are not expanded, only what is built is walked
+    FACT_TREE_WALK_BUILT = 1 << 4
+} fact_tree_walk_flag_t;
+
+typedef enum fact_tree_walk_stage_t
+{
+    FACT_TREE_WALK_STAGE_ENTER,
+    FACT_TREE_WALK_STAGE_MID,
+    FACT_TREE_WALK_STAGE_EXIT
+} fact_tree_walk_stage_t;
+
+typedef struct fact_tree_walk_frame_t
+{
+    fact_tree_node_t* node;
+    size_t depth;
+    fact_tree_walk_stage_t stage;
+} fact_tree_walk_frame_t;
+
+// Iterative depth-first walk with an explicit stack, so trees of any
+// depth are walked in one loop without recursion. The events asked for
+// in flags are returned one by one by fact_tree_walk_next, left first:
+//
+//     fact_tree_walk_t walk;
+//     fact_tree_walk_begin(&walk, ftree, root, FACT_TREE_WALK_PRE);
+//
+//     while(fact_tree_walk_next(&walk))
+//         if(...) break;
+//
+//     err = fact_tree_walk_end(&walk);
+//
+// Leaving the loop early stops the walk, fact_tree_walk_skip
+// called on a pre-order event leaves out the rest of the subtree.
+// NOTE frames may point into the walk, it must not be copied
+typedef struct fact_tree_walk_t
+{
+    fact_tree_t* ftree;
+    unsigned flags;
+
+    // step returned by the last fact_tree_walk_next
+    fact_tree_node_t* node;
+    size_t depth;
+    fact_tree_walk_event_t event;
+
+    stk_t<fact_tree_walk_frame_t, FACT_TREE_WALK_INLINE_FRAMES> frames;
+
+    fact_tree_err_t err;
+
+    // children pushed along with the last pre-order event
+    size_t pushed;
+} fact_tree_walk_t;
+
+// flags are fact_tree_walk_event_t and fact_tree_walk_flag_t or'ed
+// together. root may be NULL, then nothing is walked
+void fact_tree_walk_begin(fact_tree_walk_t* walk, fact_tree_t* ftree, fact_tree_node_t* root, unsigned flags);
+
+// Releases the frames, returns the error the walk was cut short by:
+// FACT_TREE_ALLOC_FAIL if the stack could not grow, or that of
+// fact_tree_expand if a lazy node could not be expanded
+fact_tree_err_t fact_tree_walk_end(fact_tree_walk_t* walk);
+
+// Returns 0 once the walk is over
+int fact_tree_walk_next(fact_tree_walk_t* walk);
+
+// Child of node the way the walk sees it, lazy nodes are expanded
+// unless the walk is FACT_TREE_WALK_BUILT. A node that cannot be
+// expanded sets err and empties the walk
+static inline fact_tree_node_t* fact_tree_walk_child(fact_tree_walk_t* walk, fact_tree_node_t* node, int right)
+{
+    if(node->lazy && !(walk->flags & FACT_TREE_WALK_BUILT)) {
+        fact_tree_err_t err = fact_tree_expand(walk->ftree, node);
+
+        if(err != FACT_TREE_ERR_NONE) {
+            walk->err  = err;
+            walk->frames.size = 0;
+            return NULL;
+        }
+    }
+
+    return right ? node->right : node->left;
+}
+
+// Leaves out the children and the remaining events of the node
+// just returned, which must be a pre-order event
+static inline void fact_tree_walk_skip(fact_tree_walk_t* walk)
+{
+    if(walk->event != FACT_TREE_WALK_PRE)
+        return;
+
+    // staged walks keep the node itself under its left child
+    int staged = (walk->flags & (FACT_TREE_WALK_IN | FACT_TREE_WALK_POST)) != 0;
+
+    walk->frames.size -= walk->pushed + (size_t) staged;
+    walk->pushed = 0;
+}
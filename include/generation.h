@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define GENERATION_MAGIC "EXYSTGEN"
+
+typedef enum generation_err_t
+{
+    GENERATION_ERR_NONE,
+    GENERATION_IO_ERR,
+    GENERATION_FORMAT_ERR,
+    GENERATION_READ_ONLY
+} generation_err_t;
+
+// NOTE the control file is mapped shared by every process
+// using the database, value is only accessed atomically
+typedef struct generation_header_t
+{
+    char magic[sizeof(GENERATION_MAGIC) - 1];
+    uint64_t value;
+} generation_header_t;
+
+static_assert(sizeof(generation_header_t) == 16, "generation header must be 16 bytes");
+
+// Version counter of a database shared between processes. The writer
+// replaces the database file first and bumps the counter after it, so
+// a reader that saw a value has at least that version of the file
+typedef struct generation_t
+{
+    int fd;
+    int writable;
+    generation_header_t* header;
+} generation_t;
+
+// Opens or creates the control file, read-only if it cannot be written
+generation_err_t generation_open(generation_t* gen, const char* path);
+
+uint64_t generation_get(const generation_t* gen);
+
+// Publishes a new version, returns GENERATION_READ_ONLY
+// if the control file was opened read-only
+generation_err_t generation_bump(generation_t* gen, uint64_t* value);
+
+generation_err_t generation_close(generation_t* gen);
+
+const char* generation_strerr(generation_err_t err);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define JOURNAL_MAGIC "EXYSTJNL"
+#define JOURNAL_VERSION 1u
+
+typedef enum journal_err_t
+{
+    JOURNAL_ERR_NONE,
+    JOURNAL_IO_ERR,
+    JOURNAL_ALLOC_FAIL,
+    JOURNAL_APPLY_FAIL
+} journal_err_t;
+
+// Identity of the database snapshot the journal applies to,
+// a journal written against another snapshot is discarded
+typedef struct journal_base_t
+{
+    uint64_t size;
+    int64_t mtime_ns;
+} journal_base_t;
+
+typedef struct journal_header_t
+{
+    char magic[sizeof(JOURNAL_MAGIC) - 1];
+    uint32_t version;
+    uint32_t reserved;
+    journal_base_t base;
+} journal_header_t;
+
+static_assert(sizeof(journal_header_t) == 32, "journal header must be 32 bytes");
+
+// NOTE record is followed by (depth + 7) / 8 bytes of path,
+// then the name and the question, none of them null-terminated.
+// checksum is djb2 of everything after the checksum field
+typedef struct journal_record_t
+{
+    uint32_t checksum;
+    uint32_t depth;
+    uint32_t name_len;
+    uint32_t question_len;
+} journal_record_t;
+
+static_assert(sizeof(journal_record_t) == 16, "journal record must be 16 bytes");
+
+// One insert: bit i of path is set if the i-th step
+// from the root to the target leaf goes right
+typedef struct journal_entry_t
+{
+    const uint8_t* path;
+    uint32_t depth;
+
+    const char* name;
+    uint32_t name_len;
+
+    const char* question;
+    uint32_t question_len;
+} journal_entry_t;
+
+// Returns 0 if the entry was applied
+typedef int (*journal_apply_t) (void* ctx, const journal_entry_t* entry);
+
+typedef struct journal_t
+{
+    int fd;
+    uint64_t size;
+    uint64_t records;
+
+    // bytes thrown away on open: a torn tail or a stale journal
+    uint64_t dropped;
+} journal_t;
+
+// Opens or creates the journal. A journal of another base
+// snapshot or with a broken header starts over empty
+journal_err_t journal_open(journal_t* journal, const char* path, const journal_base_t* base);
+
+// Applies records in order. Replay stops at the first torn or corrupted
+// record, which is what a crash in the middle of an append leaves,
+// and the journal is truncated right before it
+journal_err_t journal_replay(journal_t* journal, journal_apply_t apply, void* ctx);
+
+// Appends the record with a single write and syncs it to disk
+journal_err_t journal_append(journal_t* journal, const journal_entry_t* entry);
+
+// Drops all records, the journal now applies to base
+journal_err_t journal_reset(journal_t* journal, const journal_base_t* base);
+
+journal_err_t journal_close(journal_t* journal);
+
+const char* journal_strerr(journal_err_t err);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Subsystems memory is accounted to. Every allocation site reports
+// the bytes it holds, so the counters add up to what the program
+// itself allocated; libraries allocating on their own (logging,
+// Festival's Lisp runtime beyond its heap) only show in the peak RSS
+typedef enum memstat_kind_t
+{
+    MEMSTAT_NODES,      // arena blocks: nodes and copies of long names
+    MEMSTAT_NAMES,      // string pool tables
+    MEMSTAT_FILE,       // mapped database file, fact_tree_t::buf
+    MEMSTAT_INDEX,      // index-based copy of the tree
+    MEMSTAT_PAGES,      // buffer pool of paged databases
+    MEMSTAT_STACKS,     // path stacks
+    MEMSTAT_WRITE,      // output buffers of database writers
+    MEMSTAT_DEFS,       // cached definitions
+    MEMSTAT_FESTIVAL,   // Festival heap
+    MEMSTAT_KIND_COUNT
+} memstat_kind_t;
+
+typedef struct memstat_counter_t
+{
+    size_t allocs;
+    size_t frees;
+    size_t bytes;
+    size_t peak;
+} memstat_counter_t;
+
+// NOTE counters are updated atomically, parser workers allocate in parallel
+void memstat_alloc(memstat_kind_t kind, size_t bytes);
+
+void memstat_free(memstat_kind_t kind, size_t bytes);
+
+// Accounts a realloc, both buffers count towards the peak
+static inline void memstat_resize(memstat_kind_t kind, size_t bytes_old, size_t bytes_new)
+{
+    if(bytes_new)
+        memstat_alloc(kind, bytes_new);
+
+    if(bytes_old)
+        memstat_free(kind, bytes_old);
+}
+
+memstat_counter_t memstat_get(memstat_kind_t kind);
+
+// Bytes held by all subsystems together, now and at most
+memstat_counter_t memstat_total();
+
+const char* memstat_name(memstat_kind_t kind);
+
+// Prints a table of the counters and the peak RSS of the process
+void memstat_print(FILE* stream);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define PAGE_STORE_PAGE_SIZE 4096
+#define PAGE_STORE_MIN_FRAMES 4
+
+typedef enum page_store_err_t
+{
+    PAGE_STORE_ERR_NONE,
+    PAGE_STORE_IO_ERR,
+    PAGE_STORE_ALLOC_FAIL
+} page_store_err_t;
+
+typedef enum page_store_mode_t
+{
+    PAGE_STORE_READ,
+    PAGE_STORE_WRITE,
+    PAGE_STORE_CREATE
+} page_store_mode_t;
+
+// Buffer pool frame, frames are kept in an intrusive LRU list
+// and chained into buckets of the page -> frame hash table
+typedef struct page_store_frame_t
+{
+    uint64_t page;
+    int dirty;
+
+    size_t lru_prev;
+    size_t lru_next;
+    size_t hash_next;
+} page_store_frame_t;
+
+typedef struct page_store_stats_t
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t writebacks;
+} page_store_stats_t;
+
+// File of fixed-size pages read and written through an LRU
+// buffer pool, so only frames_capacity pages are ever in memory
+typedef struct page_store_t
+{
+    int fd;
+    int readonly;
+
+    // a created store is written next to path until page_store_commit
+    char* path;
+    char* tmp_path;
+    uint64_t page_count;
+
+    char* data;
+    page_store_frame_t* frames;
+    size_t frames_size;
+    size_t frames_capacity;
+
+    size_t* buckets;
+    size_t buckets_size;
+
+    // most recently used first
+    size_t lru_head;
+    size_t lru_tail;
+
+    page_store_stats_t stats;
+} page_store_t;
+
+// pool_size is the memory cap in bytes, at least PAGE_STORE_MIN_FRAMES pages.
+// PAGE_STORE_CREATE builds a new file under a temporary name next to
+// filename, which is only replaced by page_store_commit. Other modes
+// open filename itself, which must hold whole pages.
+// A store opened with PAGE_STORE_READ refuses dirty pages and appends
+page_store_err_t page_store_open(page_store_t* store, const char* filename, size_t pool_size, page_store_mode_t mode);
+
+// Returns the page or NULL on error. The pointer is only valid until
+// the next call on the store: callers copy out what they need.
+// With dirty set the page is written back on eviction or flush
+char* page_store_get(page_store_t* store, uint64_t page, int dirty);
+
+// Appends a zeroed page to the file
+page_store_err_t page_store_append(page_store_t* store, uint64_t* page);
+
+page_store_err_t page_store_flush(page_store_t* store);
+
+// Closes the store, a created one that was not committed is removed
+page_store_err_t page_store_close(page_store_t* store);
+
+// Flushes a created store, renames it over its target like wbuf_commit
+// and closes it. On error the target is left as is
+page_store_err_t page_store_commit(page_store_t* store);
+
+const char* page_store_strerr(page_store_err_t err);
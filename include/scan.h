@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+typedef enum scan_token_kind_t
+{
+    SCAN_TOKEN_OPEN,
+    SCAN_TOKEN_CLOSE,
+    SCAN_TOKEN_STRING,
+    SCAN_TOKEN_NIL,
+    SCAN_TOKEN_END,
+    SCAN_TOKEN_INVALID
+} scan_token_kind_t;
+
+// Token of the database text format. pos and len cover the whole
+// token, for SCAN_TOKEN_STRING that includes both quotes.
+typedef struct scan_token_t
+{
+    scan_token_kind_t kind;
+    size_t pos;
+    size_t len;
+} scan_token_t;
+
+size_t scan_skip_spaces(const char* buf, size_t len, size_t pos);
+
+size_t scan_find_char(const char* buf, size_t len, size_t pos, char chr);
+
+scan_token_t scan_next_token(const char* buf, size_t len, size_t pos);
+
+// Offsets of '(' and ')' outside of quoted names, in file order
+typedef struct scan_index_t
+{
+    size_t* offs;
+    size_t size;
+    size_t capacity;
+} scan_index_t;
+
+// Builds the index in a single pass over 64-byte blocks.
+// Returns 0 on success, -1 if memory allocation failed
+int scan_build_index(const char* buf, size_t len, scan_index_t* index);
+
+void scan_index_dtor(scan_index_t* index);
@@ -1,42 +1,10 @@
 #pragma once
 
 #include <stdlib.h>
+#include <string.h>
+#include <type_traits>
 
-#include "varinfo.h"
-#include "hashutils.h"
-
-#ifdef STACK_DEBUG
-// FIXME varname in the beginning
-#define STACK_MAKE(VARNAME)           \
-    stk_t VARNAME = {               \
-        .buffer   = NULL,             \
-        .size     = 0,                \
-        .capacity = 0,                \
-        .varinfo = {                  \
-            .line     = __LINE__,     \
-            .filename = __FILE__,     \
-            .funcname = __func__,     \
-            .varname  = #VARNAME      \
-        }                             \
-    }
-
-#define IF_DEBUG(statement) statement
-
-#else
-
-#define STACK_MAKE(VARNAME) \
-    stk_t VARNAME = {     \
-        .buffer   = NULL,   \
-        .size     = 0,      \
-        .capacity = 0       \
-    } 
-
-#define IF_DEBUG(statement) 
-
-#endif // _DEBUG
-
-typedef struct fact_tree_node_t fact_tree_node_t;
-typedef const fact_tree_node_t* stack_data_t;
+#include "memstat.h"
 
 typedef enum stack_err_t
 {
@@ -45,43 +13,156 @@ typedef enum stack_err_t
     STACK_ERR_BUFFER_NULL,
     STACK_ERR_SIZE_EXCEED_CAPACITY,
     STACK_ERR_ALLOC_FAIL,
-    STACK_ERR_OUT_OF_BOUND,
-    STACK_ERR_CANARY_ESCAPED,
-    STACK_ERR_HASH_UNMATCH
+    STACK_ERR_OUT_OF_BOUND
 } stack_err_t;
 
-typedef struct stk_t
+// Checked stacks validate themselves on every operation and report
+// misuse, unchecked ones compile down to plain array accesses
+#ifdef _DEBUG
+static constexpr bool STACK_CHECKED = true;
+#else
+static constexpr bool STACK_CHECKED = false;
+#endif // _DEBUG
+
+// Stack of T keeping the first INLINE elements in the stack object
+// itself, so stacks no deeper than that never allocate. Elements are
+// moved with memcpy once the stack outgrows the inline buffer.
+// NOTE buffer may point into the stack, it must not be copied
+template <typename T, size_t INLINE, bool CHECKED = STACK_CHECKED>
+struct stk_t
 {
-    IF_DEBUG(
-#ifdef CANARY_ENABLED
-        stack_data_t canary_begin
-#endif // CANARY_ENABLED
-    );
+    static_assert(std::is_trivially_copyable<T>::value, "stack elements are moved with memcpy");
+    static_assert(INLINE > 0, "inline buffer must not be empty");
 
-    stack_data_t* buffer;
+    T* buffer;
     size_t size;
     size_t capacity;
 
-    IF_DEBUG(
-        const varinfo_t varinfo;
+    T inline_buffer[INLINE];
+};
 
-#ifdef HASH_ENABLED
-        utils_hash_t buffer_hash;
-#endif // HASH_ENABLED
+const char* stack_strerr(const stack_err_t err);
+
+// Logs an error found by a checked stack
+void stack_report(stack_err_t err, const char* funcname);
+
+template <typename T, size_t INLINE, bool CHECKED>
+void stack_ctor(stk_t<T, INLINE, CHECKED>* stk)
+{
+    stk->buffer   = stk->inline_buffer;
+    stk->size     = 0;
+    stk->capacity = INLINE;
+}
 
-#ifdef CANARY_ENABLED
-        stack_data_t canary_end;
-#endif // CANARY_ENABLED
-    );
-} stk_t;
+template <typename T, size_t INLINE, bool CHECKED>
+stack_err_t stack_validate(const stk_t<T, INLINE, CHECKED>* stk)
+{
+    if(stk == NULL)
+        return STACK_ERR_NULL;
 
-stack_err_t stack_ctor(stk_t* stk, size_t capacity);
+    if(stk->buffer == NULL)
+        return STACK_ERR_BUFFER_NULL;
 
-stack_err_t stack_push(stk_t* stk, stack_data_t val);
+    if(stk->size > stk->capacity)
+        return STACK_ERR_SIZE_EXCEED_CAPACITY;
 
-stack_err_t stack_pop(stk_t* stk, stack_data_t* val);
+    return STACK_ERR_NONE;
+}
 
-const char* stack_strerr(const stack_err_t err);
+// Makes room for capacity elements, so that pushing
+// that many never reallocates
+template <typename T, size_t INLINE, bool CHECKED>
+stack_err_t stack_reserve(stk_t<T, INLINE, CHECKED>* stk, size_t capacity)
+{
+    if(capacity <= stk->capacity)
+        return STACK_ERR_NONE;
+
+    T* buffer = (T*) calloc(capacity, sizeof(T));
+    if(!buffer)
+        return STACK_ERR_ALLOC_FAIL;
+
+    memcpy(buffer, stk->buffer, stk->size * sizeof(T));
+
+    if(stk->buffer != stk->inline_buffer) {
+        memstat_free(MEMSTAT_STACKS, stk->capacity * sizeof(T));
+        free(stk->buffer);
+    }
 
-void stack_dtor(stk_t* stk);
+    memstat_alloc(MEMSTAT_STACKS, capacity * sizeof(T));
+
+    stk->buffer   = buffer;
+    stk->capacity = capacity;
+
+    return STACK_ERR_NONE;
+}
+
+template <typename T, size_t INLINE, bool CHECKED>
+stack_err_t stack_push(stk_t<T, INLINE, CHECKED>* stk, T val)
+{
+    stack_err_t err = STACK_ERR_NONE;
+
+    if constexpr(CHECKED) {
+        err = stack_validate(stk);
+
+        if(err != STACK_ERR_NONE) {
+            stack_report(err, __func__);
+            return err;
+        }
+    }
+
+    if(stk->size == stk->capacity) {
+        err = stack_reserve(stk, stk->capacity * 2);
+
+        if(err != STACK_ERR_NONE) {
+            if constexpr(CHECKED)
+                stack_report(err, __func__);
+            return err;
+        }
+    }
+
+    stk->buffer[stk->size++] = val;
+
+    return err;
+}
+
+template <typename T, size_t INLINE, bool CHECKED>
+stack_err_t stack_pop(stk_t<T, INLINE, CHECKED>* stk, T* val)
+{
+    if constexpr(CHECKED) {
+        stack_err_t err = stack_validate(stk);
+
+        if(err == STACK_ERR_NONE && stk->size == 0)
+            err = STACK_ERR_OUT_OF_BOUND;
+        else if(err == STACK_ERR_NONE && val == NULL)
+            err = STACK_ERR_NULL;
+
+        if(err != STACK_ERR_NONE) {
+            stack_report(err, __func__);
+            return err;
+        }
+    }
+
+    *val = stk->buffer[--stk->size];
+
+    return STACK_ERR_NONE;
+}
+
+template <typename T, size_t INLINE, bool CHECKED>
+void stack_dtor(stk_t<T, INLINE, CHECKED>* stk)
+{
+    if constexpr(CHECKED) {
+        stack_err_t err = stack_validate(stk);
+
+        if(err != STACK_ERR_NONE) {
+            stack_report(err, __func__);
+            return;
+        }
+    }
+
+    if(stk->buffer != stk->inline_buffer) {
+        memstat_free(MEMSTAT_STACKS, stk->capacity * sizeof(T));
+        free(stk->buffer);
+    }
 
+    stack_ctor(stk);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <time.h>
+
+// Monotonic time since stopwatch_start, for the timings in debug logs
+typedef struct stopwatch_t
+{
+    struct timespec begin;
+} stopwatch_t;
+
+static inline void stopwatch_start(stopwatch_t* stopwatch)
+{
+    clock_gettime(CLOCK_MONOTONIC, &stopwatch->begin);
+}
+
+// Seconds since stopwatch_start
+static inline double stopwatch_s(const stopwatch_t* stopwatch)
+{
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)(now.tv_sec - stopwatch->begin.tv_sec)
+         + (double)(now.tv_nsec - stopwatch->begin.tv_nsec) * 1e-9;
+}
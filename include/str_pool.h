@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "stringutils.h"
+#include "arena.h"
+
+// id 0 is never handed out, zeroed nodes start without an id
+#define STR_POOL_NONE 0u
+#define STR_POOL_INIT_CAPACITY 64
+
+#define STR_POOL_INIT_LIST  \
+    {                       \
+        .strs = NULL,       \
+        .hashes = NULL,     \
+        .size = 0,          \
+        .capacity = 0,      \
+        .table = NULL,      \
+        .table_size = 0,    \
+        .stats = {          \
+            .interned = 0,  \
+            .shared = 0,    \
+            .shared_bytes = 0 \
+        }                   \
+    }
+
+typedef struct str_pool_stats_t
+{
+    size_t interned;
+    size_t shared;
+    size_t shared_bytes;
+} str_pool_stats_t;
+
+// Deduplicating table of strings with stable ids. Borrowed strings
+// must stay alive as long as the pool, copies are made in an arena
+typedef struct str_pool_t
+{
+    // id -> string and its hash, entry 0 is unused
+    utils_str_t* strs;
+    uint32_t* hashes;
+    size_t size;
+    size_t capacity;
+
+    // open addressing hash -> id, STR_POOL_NONE marks a free slot
+    uint32_t* table;
+    size_t table_size;
+
+    str_pool_stats_t stats;
+} str_pool_t;
+
+void str_pool_dtor(str_pool_t* pool);
+
+// Returns the id of the string, STR_POOL_NONE if it was never interned
+uint32_t str_pool_find(const str_pool_t* pool, const char* str, size_t len);
+
+// Returns the id of an equal string interned before or adds str under
+// a new id. Returns STR_POOL_NONE if the pool cannot grow
+uint32_t str_pool_intern(str_pool_t* pool, char* str, size_t len);
+
+// Same as str_pool_intern, but a new string is first copied into arena,
+// so only one copy of every distinct string is ever made
+uint32_t str_pool_intern_copy(str_pool_t* pool, const char* str, size_t len, arena_t* arena);
+
+static inline utils_str_t str_pool_get(const str_pool_t* pool, uint32_t id)
+{
+    return pool->strs[id];
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define WBUF_CAPACITY (1ul << 20)
+#define WBUF_MEM_INIT_CAPACITY (1ul << 16)
+
+typedef enum wbuf_err_t
+{
+    WBUF_ERR_NONE,
+    WBUF_IO_ERR,
+    WBUF_ALLOC_FAIL
+} wbuf_err_t;
+
+// Output buffer over a temporary file next to the target. Nothing
+// replaces the target until wbuf_commit: it flushes, fsyncs and
+// renames the temporary file into place, then fsyncs the directory.
+// Errors are sticky, puts after a failed write are ignored and
+// the first error is returned by wbuf_commit.
+// A buffer opened with wbuf_open_mem has no file and grows instead
+// of flushing, it is read from data and size and freed with wbuf_free
+typedef struct wbuf_t
+{
+    int fd;
+    char* path;
+    char* tmp_path;
+
+    char* data;
+    size_t size;
+    size_t capacity;
+
+    uint64_t written;
+    wbuf_err_t err;
+} wbuf_t;
+
+wbuf_err_t wbuf_open(wbuf_t* wbuf, const char* path);
+
+wbuf_err_t wbuf_open_mem(wbuf_t* wbuf);
+
+void wbuf_free(wbuf_t* wbuf);
+
+wbuf_err_t wbuf_flush(wbuf_t* wbuf);
+
+// Publishes the file and frees the buffer, on error the target is left as is
+wbuf_err_t wbuf_commit(wbuf_t* wbuf);
+
+const char* wbuf_strerr(wbuf_err_t err);
+
+// Syncs the directory holding path, a rename into it is durable only then
+wbuf_err_t wbuf_fsync_dir(const char* path);
+
+// Flushes or grows the buffer, data larger than the buffer is written directly
+void wbuf_put_slow(wbuf_t* wbuf, const void* data, size_t len);
+
+static inline void wbuf_put(wbuf_t* wbuf, const void* data, size_t len)
+{
+    if(wbuf->size + len > wbuf->capacity) {
+        wbuf_put_slow(wbuf, data, len);
+        return;
+    }
+
+    memcpy(wbuf->data + wbuf->size, data, len);
+    wbuf->size += len;
+}
+
+#define WBUF_PUT_LITERAL(wbuf, literal) \
+    wbuf_put(wbuf, literal, sizeof(literal) - 1)
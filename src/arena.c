@@ -0,0 +1,87 @@
+#include "arena.h"
+
+#include <string.h>
+
+#include "memstat.h"
+
+void* arena_alloc_slow(arena_t* arena, size_t size)
+{
+    size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+
+    arena_block_t* block = (arena_block_t*) calloc(1, sizeof(arena_block_t) + capacity);
+    if(!block)
+        return NULL;
+
+    memstat_alloc(MEMSTAT_NODES, sizeof(arena_block_t) + capacity);
+
+    block->capacity = capacity;
+    block->used     = size;
+
+    // an oversized block is full right away, keep bumping in the current one
+    if(arena->head && size >= ARENA_BLOCK_SIZE) {
+        block->next       = arena->head->next;
+        arena->head->next = block;
+    }
+    else {
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    arena->stats.allocs++;
+    arena->stats.blocks++;
+    arena->stats.bytes += size;
+
+    return block + 1;
+}
+
+char* arena_strndup(arena_t* arena, const char* str, size_t len)
+{
+    char* copy = (char*) arena_alloc(arena, len + 1);
+    if(!copy)
+        return NULL;
+
+    memcpy(copy, str, len);
+
+    return copy;
+}
+
+void arena_merge(arena_t* dst, arena_t* src)
+{
+    if(!src->head)
+        return;
+
+    if(!dst->head) {
+        dst->head = src->head;
+    }
+    else {
+        arena_block_t* tail = src->head;
+        while(tail->next)
+            tail = tail->next;
+
+        // the partly used head of dst stays the one allocations are made from
+        tail->next      = dst->head->next;
+        dst->head->next = src->head;
+    }
+
+    dst->stats.allocs += src->stats.allocs;
+    dst->stats.blocks += src->stats.blocks;
+    dst->stats.bytes  += src->stats.bytes;
+
+    src->head  = NULL;
+    src->stats = {};
+}
+
+void arena_free(arena_t* arena)
+{
+    arena_block_t* block = arena->head;
+
+    while(block) {
+        arena_block_t* next = block->next;
+        memstat_free(MEMSTAT_NODES, sizeof(arena_block_t) + block->capacity);
+        free(block);
+        block = next;
+    }
+
+    arena->head  = NULL;
+    arena->stats = {};
+}
@@ -0,0 +1,228 @@
+#include "def_cache.h"
+
+#include <string.h>
+
+#include "memutils.h"
+#include "assertutils.h"
+#include "memstat.h"
+
+#define FIB_MULT_ 0x9e3779b97f4a7c15ull
+
+// Keys are node addresses: their low bits are the same for
+// every node, the multiply moves the varying ones up
+static size_t def_cache_slot_(const def_cache_t* cache, const void* key)
+{
+    uint64_t hash = (uintptr_t) key * FIB_MULT_;
+
+    return (hash ^ (hash >> 32)) & (cache->table_size - 1);
+}
+
+static size_t def_cache_entry_bytes_(size_t len)
+{
+    return sizeof(def_cache_entry_t) + len + 1;
+}
+
+static const char* def_cache_text_(const def_cache_entry_t* entry)
+{
+    return (const char*)(entry + 1);
+}
+
+static def_cache_entry_t** def_cache_find_(const def_cache_t* cache, const void* key)
+{
+    if(!cache->table_size)
+        return NULL;
+
+    def_cache_entry_t** link = &cache->table[def_cache_slot_(cache, key)];
+
+    while(*link && (*link)->key != key)
+        link = &(*link)->next;
+
+    return *link ? link : NULL;
+}
+
+static void def_cache_unlink_(def_cache_t* cache, def_cache_entry_t* entry)
+{
+    if(entry->newer)
+        entry->newer->older = entry->older;
+    else
+        cache->newest = entry->older;
+
+    if(entry->older)
+        entry->older->newer = entry->newer;
+    else
+        cache->oldest = entry->newer;
+
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+static void def_cache_link_newest_(def_cache_t* cache, def_cache_entry_t* entry)
+{
+    entry->newer = NULL;
+    entry->older = cache->newest;
+
+    if(cache->newest)
+        cache->newest->newer = entry;
+    else
+        cache->oldest = entry;
+
+    cache->newest = entry;
+}
+
+// Takes the entry out of its slot and the order of use, link is where it is chained from
+static void def_cache_erase_(def_cache_t* cache, def_cache_entry_t** link)
+{
+    def_cache_entry_t* entry = *link;
+
+    *link = entry->next;
+    def_cache_unlink_(cache, entry);
+
+    size_t bytes = def_cache_entry_bytes_(entry->len);
+
+    memstat_free(MEMSTAT_DEFS, bytes);
+    free(entry);
+
+    cache->bytes -= bytes;
+    --cache->size;
+}
+
+static void def_cache_evict_(def_cache_t* cache, size_t budget)
+{
+    while(cache->oldest && cache->bytes > budget) {
+        def_cache_entry_t** link = def_cache_find_(cache, cache->oldest->key);
+        utils_assert(link);
+
+        def_cache_erase_(cache, link);
+        ++cache->stats.evicted;
+    }
+}
+
+// Keeps the table no fuller than one entry per slot. A table that
+// cannot grow stays as it is, chains just get longer
+static void def_cache_rehash_(def_cache_t* cache, size_t size)
+{
+    if(size <= cache->table_size)
+        return;
+
+    size_t table_size = cache->table_size ? cache->table_size * 2 : DEF_CACHE_INIT_CAPACITY;
+
+    def_cache_entry_t** table = TYPED_CALLOC(table_size, def_cache_entry_t*);
+    if(!table)
+        return;
+
+    memstat_resize(MEMSTAT_DEFS, cache->table_size * sizeof(table[0]), table_size * sizeof(table[0]));
+
+    free(cache->table);
+
+    cache->table      = table;
+    cache->table_size = table_size;
+
+    for(def_cache_entry_t* entry = cache->newest; entry; entry = entry->older) {
+        size_t slot = def_cache_slot_(cache, entry->key);
+
+        entry->next = table[slot];
+        table[slot] = entry;
+    }
+}
+
+void def_cache_set_budget(def_cache_t* cache, size_t budget)
+{
+    utils_assert(cache);
+
+    cache->budget = budget;
+
+    def_cache_evict_(cache, budget);
+}
+
+void def_cache_clear(def_cache_t* cache)
+{
+    utils_assert(cache);
+
+    def_cache_evict_(cache, 0);
+
+    if(cache->table_size)
+        memstat_free(MEMSTAT_DEFS, cache->table_size * sizeof(cache->table[0]));
+
+    NFREE(cache->table);
+    cache->table_size = 0;
+}
+
+const char* def_cache_get(def_cache_t* cache, const void* key, size_t* len)
+{
+    utils_assert(cache);
+    utils_assert(len);
+
+    if(!cache->budget)
+        return NULL;
+
+    def_cache_entry_t** link = def_cache_find_(cache, key);
+
+    if(!link) {
+        ++cache->stats.misses;
+        return NULL;
+    }
+
+    def_cache_entry_t* entry = *link;
+
+    def_cache_unlink_(cache, entry);
+    def_cache_link_newest_(cache, entry);
+
+    ++cache->stats.hits;
+
+    *len = entry->len;
+    return def_cache_text_(entry);
+}
+
+int def_cache_put(def_cache_t* cache, const void* key, const char* text, size_t len)
+{
+    utils_assert(cache);
+    utils_assert(text);
+
+    def_cache_remove(cache, key);
+
+    size_t bytes = def_cache_entry_bytes_(len);
+    if(bytes > cache->budget)
+        return 0;
+
+    def_cache_evict_(cache, cache->budget - bytes);
+
+    // a table is needed before anything can be cached
+    def_cache_rehash_(cache, cache->size + 1);
+    cache->table_size verified(return 0);
+
+    def_cache_entry_t* entry = (def_cache_entry_t*) malloc(bytes);
+    entry verified(return 0);
+
+    memstat_alloc(MEMSTAT_DEFS, bytes);
+
+    entry->key = key;
+    entry->len = len;
+
+    char* entry_text = (char*)(entry + 1);
+    memcpy(entry_text, text, len);
+    entry_text[len] = '\0';
+
+    size_t slot = def_cache_slot_(cache, key);
+
+    entry->next = cache->table[slot];
+    cache->table[slot] = entry;
+
+    def_cache_link_newest_(cache, entry);
+
+    ++cache->size;
+    cache->bytes += bytes;
+
+    return 1;
+}
+
+void def_cache_remove(def_cache_t* cache, const void* key)
+{
+    utils_assert(cache);
+
+    def_cache_entry_t** link = def_cache_find_(cache, key);
+
+    if(link)
+        def_cache_erase_(cache, link);
+}
+
+#undef FIB_MULT_
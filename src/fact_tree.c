@@ -5,8 +5,17 @@
 #include <ctype.h>
 #include <time.h>
 #include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <festival/festival.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "colorutils.h"
 #include "logutils.h"
 #include "memutils.h"
@@ -16,6 +25,21 @@
 #include "assertutils.h"
 #include "logutils.h"
 #include "stack.h"
+#include "scan.h"
+#include "fact_tree_bin.h"
+#include "fact_tree_pages.h"
+#include "wbuf.h"
+#include "journal.h"
+#include "generation.h"
+#include "arena.h"
+#include "fact_tree_soa.h"
+#include "fact_tree_index.h"
+#include "fact_tree_layout.h"
+#include "fact_tree_walk.h"
+#include "fact_tree_render.h"
+#include "fact_tree_query.h"
+#include "memstat.h"
+#include "stopwatch.h"
 
 #define LOG_CATEGORY_FTREE "FACT TREE"
 
@@ -23,6 +47,10 @@
 #define CHAR_ACCEPT_ 'y'
 #define CHAR_DECLINE_ 'n'
 #define NIL_STR "nil"
+#define JOURNAL_SUFFIX_ ".journal"
+#define JOURNAL_COMPACT_SIZE_ (1ul << 20)
+#define GENERATION_SUFFIX_ ".ctl"
+#define FACT_TREE_SOA_NODE_BYTES_ (sizeof(fact_tree_soa_link_t) + sizeof(uint32_t) + sizeof(fact_tree_node_t*))
 
 #ifdef _DEBUG
 
@@ -35,503 +63,2625 @@
         }                                                    \
     }
 
-#else // _DEBUG
+#else // _DEBUG
+
+#define FACT_TREE_ASSERT_OK_(fact_tree) 
+
+#endif // _DEBUG
+
+static fact_tree_err_t fact_tree_allocate_new_node_(arena_t* arena, fact_tree_node_t** node, utils_str_t title);
+
+static void fact_tree_set_name_(fact_tree_node_t* node, char* str, size_t len);
+
+static void fact_tree_swap_nodes_(fact_tree_node_t* node_a, fact_tree_node_t* node_b);
+
+static void fact_tree_node_link_one_(fact_tree_node_t* node);
+
+static void fact_tree_link_(fact_tree_node_t* top);
+
+typedef struct fact_tree_writer_t fact_tree_writer_t;
+
+static void fact_tree_fwrite_node_(fact_tree_t* ftree, fact_tree_node_t* node, fact_tree_writer_t* writer);
+
+static fact_tree_err_t fact_tree_fread_text_(fact_tree_t* ftree, const char* fname);
+
+static fact_tree_err_t fact_tree_fread_bin_(fact_tree_t* ftree, const char* fname, int lazy);
+
+static fact_tree_err_t fact_tree_fread_text_lazy_(fact_tree_t* ftree, const char* fname);
+
+static fact_tree_err_t fact_tree_fread_(fact_tree_t* ftree, const char* filename, int lazy, int journaled);
+
+// Builds one of the structures derived from the tree into built,
+// which is zeroed, and puts the count of what it holds into count
+typedef fact_tree_err_t (*fact_tree_lazy_build_fn_t)(fact_tree_t* ftree, void* built, size_t* count);
+
+static fact_tree_soa_t* fact_tree_soa_(fact_tree_t* ftree);
+
+static void fact_tree_soa_drop_(fact_tree_t* ftree);
+
+static fact_tree_index_t* fact_tree_index_(fact_tree_t* ftree);
+
+static void fact_tree_index_drop_(fact_tree_t* ftree);
+
+static fact_tree_attrs_t* fact_tree_attrs_(fact_tree_t* ftree);
+
+static void fact_tree_attrs_drop_(fact_tree_t* ftree);
+
+static void fact_tree_index_insert_(fact_tree_t* ftree, const fact_tree_node_t* node, fact_tree_node_t* old, fact_tree_node_t* added);
+
+static int fact_tree_buf_is_bin_(fact_tree_t* ftree);
+
+static fact_tree_err_t fact_tree_journal_open_(fact_tree_t* ftree, const char* filename);
+
+static void fact_tree_journal_close_(fact_tree_t* ftree);
+
+static fact_tree_err_t fact_tree_journal_append_(fact_tree_t* ftree, const fact_tree_node_t* node, const fact_tree_node_t* added);
+
+static fact_tree_err_t fact_tree_journal_saved_(fact_tree_t* ftree, const char* filename, int bin);
+
+static fact_tree_err_t fact_tree_journal_fold_(fact_tree_t* ftree);
+
+static int fact_tree_name_equals_(const fact_tree_node_t* node, const char* str, size_t len);
+
+static void fact_tree_say_(const char* text);
+
+#ifdef _DEBUG
+
+static char* fact_tree_dump_graphviz_(fact_tree_t* fact_tree);
+
+static void fact_tree_dump_node_graphviz_(FILE* file, fact_tree_node_t* node, int rank);
+
+fact_tree_err_t fact_tree_verify_(fact_tree_t* fact_tree);
+
+#endif // _DEBUG
+
+fact_tree_err_t fact_tree_ctor(fact_tree_t* fact_tree)
+{
+    utils_assert(fact_tree);
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    err = fact_tree_copy_name(fact_tree, DEFAULT_NODE_, SIZEOF(DEFAULT_NODE_) - 1, &fact_tree->root);
+    err == FACT_TREE_ERR_NONE verified(return err);
+
+    fact_tree->size = 1;
+
+    FACT_TREE_DUMP(fact_tree, err);
+
+    return FACT_TREE_ERR_NONE;
+}
+
+void fact_tree_dtor(fact_tree_t* fact_tree)
+{
+    utils_assert(fact_tree);
+
+    if(fact_tree->arena.head) {
+        stopwatch_t stopwatch = {};
+        stopwatch_start(&stopwatch);
+
+        arena_stats_t stats = fact_tree->arena.stats;
+        arena_free(&fact_tree->arena);
+
+        double elapsed_s = stopwatch_s(&stopwatch);
+
+        UTILS_LOGD(
+            LOG_CATEGORY_FTREE, 
+            "freed %zu nodes: %zu allocations in %zu blocks, %zu bytes in %.3f ms", 
+            fact_tree->size, 
+            stats.allocs, 
+            stats.blocks, 
+            stats.bytes, 
+            elapsed_s * 1e3
+        );
+    }
+
+    fact_tree_soa_drop_(fact_tree);
+    fact_tree_index_drop_(fact_tree);
+    fact_tree_attrs_drop_(fact_tree);
+
+    if(fact_tree->defs.stats.hits || fact_tree->defs.stats.misses) {
+        UTILS_LOGD(
+            LOG_CATEGORY_FTREE, 
+            "definition cache: %zu hits, %zu misses, %zu evicted, %zu of %zu bytes held", 
+            fact_tree->defs.stats.hits, 
+            fact_tree->defs.stats.misses, 
+            fact_tree->defs.stats.evicted, 
+            fact_tree->defs.bytes, 
+            fact_tree->defs.budget
+        );
+    }
+
+    def_cache_clear(&fact_tree->defs);
+
+    if(fact_tree->names.size) {
+        UTILS_LOGD(
+            LOG_CATEGORY_FTREE, 
+            "string pool: %zu names interned, %zu duplicates share them (%zu bytes)", 
+            fact_tree->names.stats.interned, 
+            fact_tree->names.stats.shared, 
+            fact_tree->names.stats.shared_bytes
+        );
+
+        str_pool_dtor(&fact_tree->names);
+    }
+
+    if(fact_tree->lazy.store)
+        fact_tree_pages_close(fact_tree);
+
+    if(fact_tree->journal.log)
+        fact_tree_journal_close_(fact_tree);
+
+    if(fact_tree->shared.gen) {
+        generation_close(fact_tree->shared.gen);
+        NFREE(fact_tree->shared.gen);
+    }
+
+    fact_tree->shared.unsaved = 0;
+
+    fact_tree->size = 0;
+    fact_tree->root = NULL;
+
+    if(fact_tree->buf.ptr) {
+        memstat_free(MEMSTAT_FILE, (size_t) fact_tree->buf.len);
+        munmap(fact_tree->buf.ptr, (size_t) fact_tree->buf.len);
+    }
+
+    fact_tree->buf.ptr = NULL;
+    fact_tree->buf.pos = 0;
+    fact_tree->buf.len = 0;
+
+    NFREE(fact_tree->lazy.fname);
+    NFREE(fact_tree->lazy.begin);
+    NFREE(fact_tree->lazy.end);
+
+    fact_tree->lazy.size = 0;
+    fact_tree->lazy.mode = FACT_TREE_LAZY_NONE;
+}
+
+fact_tree_node_t* fact_tree_guess(fact_tree_t* fact_tree)
+{
+    FACT_TREE_ASSERT_OK_(fact_tree);
+    
+    if(!fact_tree->root) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "tree is not initialized");
+        return NULL;
+    }
+
+    fact_tree_node_t* node = fact_tree->root;
+
+    char input = CHAR_DECLINE_;
+    while(fact_tree_node_right(fact_tree, node) != NULL) {
+        utils_colored_fprintf(stdout, ANSI_COLOR_BOLD_WHITE, "Is object ... "              );
+        utils_colored_fprintf(stdout, ANSI_COLOR_CYAN,       "%.*s",         (int) node->name_len, fact_tree_node_name(node));
+        utils_colored_fprintf(stdout, ANSI_COLOR_BOLD_WHITE, "? [y/N]: "                   );
+
+        scanf("%c", &input);
+        clear_stdin_buffer();
+
+        if(input == CHAR_ACCEPT_)
+            node = fact_tree_node_right(fact_tree, node);
+        else
+            node = fact_tree_node_left(fact_tree, node);
+    }
+
+    // a question whose answers could not be read is no object
+    if(node->lazy)
+        return NULL;
+    
+    return node;
+}
+
+fact_tree_err_t fact_tree_insert(fact_tree_t* fact_tree, fact_tree_node_t* node, fact_tree_node_t** ret)
+{
+    FACT_TREE_ASSERT_OK_(fact_tree);
+    utils_assert(ret);
+    utils_assert(node);
+
+    utils_str_t diff_s = UTILS_STR_INITLIST;
+    utils_str_t entity_s = UTILS_STR_INITLIST;
+    enum io_err_t io_err = IO_ERR_NONE;
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    BEGIN {
+
+        utils_colored_fprintf(stdout, ANSI_COLOR_BOLD_WHITE, "Enter object's name: "); 
+        io_err = input_string_until_correct(&entity_s.str, &entity_s.len);
+        if(io_err != IO_ERR_NONE) {
+            err = FACT_TREE_IO_ERR;
+            GOTO_END;
+        }
+
+        utils_colored_fprintf(stdout, ANSI_COLOR_BOLD_WHITE, "Enter the difference between "                );
+        utils_colored_fprintf(stdout, ANSI_COLOR_MAGENTA,    "%s",                           entity_s.str   );
+        utils_colored_fprintf(stdout, ANSI_COLOR_BOLD_WHITE, " and "                                        );
+        utils_colored_fprintf(stdout, ANSI_COLOR_MAGENTA,    "%.*s",                         (int) node->name_len, fact_tree_node_name(node));
+        utils_colored_fprintf(stdout, ANSI_COLOR_BOLD_WHITE, ": "                                           );
+
+        io_err = input_string_until_correct(&diff_s.str, &diff_s.len);
+        if(io_err != IO_ERR_NONE) {
+            err = FACT_TREE_IO_ERR;
+            GOTO_END;
+        }
+
+        err = fact_tree_insert_object(fact_tree, node, entity_s.str, entity_s.len, diff_s.str, diff_s.len, ret);
+
+    } END;
+
+    NFREE(entity_s.str);
+    NFREE(diff_s.str);
+
+    return err;
+}
+
+fact_tree_err_t fact_tree_copy_name(fact_tree_t* ftree, const char* str, size_t len, fact_tree_node_t** node)
+{
+    uint32_t id = str_pool_intern_copy(&ftree->names, str, len, &ftree->arena);
+    id != STR_POOL_NONE verified(return FACT_TREE_ALLOC_FAIL);
+
+    fact_tree_err_t err = fact_tree_allocate_new_node_(&ftree->arena, node, str_pool_get(&ftree->names, id));
+    err == FACT_TREE_ERR_NONE verified(return err);
+
+    (*node)->name_id = id;
+
+    return FACT_TREE_ERR_NONE;
+}
+
+fact_tree_err_t fact_tree_insert_object(
+    fact_tree_t* fact_tree, 
+    fact_tree_node_t* node, 
+    const char* name, 
+    size_t name_len,
+    const char* question, 
+    size_t question_len,
+    fact_tree_node_t** ret)
+{
+    FACT_TREE_ASSERT_OK_(fact_tree);
+    utils_assert(ret);
+    utils_assert(node);
+    utils_assert(name);
+    utils_assert(question);
+
+    fact_tree_err_t err = fact_tree_expand(fact_tree, node);
+    err == FACT_TREE_ERR_NONE verified(return err);
+
+    utils_assert(!node->left && !node->right);
+
+    fact_tree_node_t *node_entity_old = NULL, *node_entity_new = NULL;
+
+    err = fact_tree_copy_name(fact_tree, question, question_len, &node_entity_old);
+    err == FACT_TREE_ERR_NONE verified(return FACT_TREE_ALLOC_FAIL);
+
+    err = fact_tree_copy_name(fact_tree, name, name_len, &node_entity_new);
+    err == FACT_TREE_ERR_NONE verified(return FACT_TREE_ALLOC_FAIL);
+
+    // a paged database is updated in place and needs no journal. Pages
+    // go first, so a failed write leaves the tree in memory as it is
+    if(fact_tree->lazy.mode == FACT_TREE_LAZY_PAGED) {
+        err = fact_tree_pages_insert(fact_tree, node, node_entity_old, node_entity_new);
+        err == FACT_TREE_ERR_NONE verified(return err);
+    }
+
+    fact_tree_swap_nodes_(node_entity_old, node);
+
+    node->left = node_entity_old;
+    node->right = node_entity_new;
+    
+    node_entity_new->parent = node;
+    node_entity_old->parent = node;
+
+    fact_tree_node_link_one_(node_entity_old);
+    fact_tree_node_link_one_(node_entity_new);
+
+    fact_tree->size += 2;
+
+    fact_tree_soa_drop_(fact_tree);
+    fact_tree_attrs_drop_(fact_tree);
+    fact_tree_index_insert_(fact_tree, node, node_entity_old, node_entity_new);
+
+    // the leaf is a question now, the two new leaves have nothing
+    // cached yet and no other definition mentions its name
+    def_cache_remove(&fact_tree->defs, node);
+
+    if(fact_tree->shared.gen)
+        ++fact_tree->shared.unsaved;
+
+    *ret = node_entity_new;
+
+    if(fact_tree->journal.log) {
+        err = fact_tree_journal_append_(fact_tree, node, node_entity_new);
+        err == FACT_TREE_ERR_NONE verified(return err);
+    }
+
+    return FACT_TREE_ERR_NONE;
+}
+
+// Leaves with an interned name are compared by id, the others by length
+// and bytes. Names are interned by the index build and by copies into
+// the arena, never here, so the walk does not write to the nodes.
+// Returns how many leaves match, puts the first max of them in
+// preorder into found and the last one into last
+static size_t fact_tree_find_object_(
+    fact_tree_t* ftree, 
+    fact_tree_node_t* node, 
+    const char* name, 
+    uint32_t name_id,
+    const fact_tree_node_t** found,
+    size_t max,
+    const fact_tree_node_t** last)
+{
+    size_t count = 0;
+    *last = NULL;
+
+    size_t name_len = strlen(name);
+
+    fact_tree_walk_t walk;
+    fact_tree_walk_begin(&walk, ftree, node, FACT_TREE_WALK_LEAF);
+
+    while(fact_tree_walk_next(&walk)) {
+        fact_tree_node_t* cur = walk.node;
+
+        // an interned name that is not name_id is some other name,
+        // even when name itself is not in the pool at all
+        int match = cur->name_id != STR_POOL_NONE
+                  ? cur->name_id == name_id
+                  : fact_tree_name_equals_(cur, name, name_len);
+
+        if(!match)
+            continue;
+
+        if(count < max)
+            found[count] = cur;
+
+        *last = cur;
+        ++count;
+    }
+
+    // the leaves found are not all there are
+    fact_tree_err_t err = fact_tree_walk_end(&walk);
+    if(err != FACT_TREE_ERR_NONE) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s", fact_tree_strerr(err));
+        *last = NULL;
+        return 0;
+    }
+
+    return count;
+}
+
+// Same as fact_tree_find_object_, only from the index
+static size_t fact_tree_index_find_(
+    const fact_tree_index_t* index, 
+    uint32_t name_id, 
+    const fact_tree_node_t** found, 
+    size_t max,
+    const fact_tree_node_t** last)
+{
+    uint32_t head = name_id != STR_POOL_NONE ? fact_tree_index_last(index, name_id) : FACT_TREE_INDEX_NIL;
+
+    *last = head != FACT_TREE_INDEX_NIL ? index->leaves[head] : NULL;
+
+    size_t count = 0;
+    for(uint32_t entry = head; entry != FACT_TREE_INDEX_NIL; entry = fact_tree_index_prev(index, entry))
+        ++count;
+
+    // the chain runs from the last leaf back
+    size_t pos = count;
+    for(uint32_t entry = head; entry != FACT_TREE_INDEX_NIL; entry = fact_tree_index_prev(index, entry))
+        if(--pos < max)
+            found[pos] = index->leaves[entry];
+
+    return count;
+}
+
+const fact_tree_node_t* fact_tree_find_object(fact_tree_t* ftree, fact_tree_node_t* node, const char* name)
+{
+    utils_assert(ftree);
+    utils_assert(node);
+    utils_assert(name);
+
+    // a paged database is searched page by page, not built as a whole
+    if(ftree->lazy.mode == FACT_TREE_LAZY_PAGED && node == ftree->root)
+        return fact_tree_pages_find(ftree, name);
+
+    const fact_tree_index_t* index = node == ftree->root ? fact_tree_index_(ftree) : NULL;
+
+    uint32_t name_id = str_pool_find(&ftree->names, name, strlen(name));
+
+    const fact_tree_node_t* last = NULL;
+
+    // with the index built every name of the tree is interned
+    if(index)
+        fact_tree_index_find_(index, name_id, NULL, 0, &last);
+    else
+        fact_tree_find_object_(ftree, node, name, name_id, NULL, 0, &last);
+
+    return last;
+}
+
+fact_tree_err_t fact_tree_find_objects(fact_tree_t* ftree, const char* name, const fact_tree_node_t** found, size_t max, size_t* count)
+{
+    utils_assert(ftree);
+    utils_assert(name);
+    utils_assert(found || !max);
+    utils_assert(count);
+
+    *count = 0;
+
+    // pages have no name index, a scan would stop at the first match
+    if(ftree->lazy.mode == FACT_TREE_LAZY_PAGED)
+        return FACT_TREE_LAZY_ERR;
+
+    if(!ftree->root)
+        return FACT_TREE_ERR_NONE;
+
+    const fact_tree_index_t* index = fact_tree_index_(ftree);
+
+    uint32_t name_id = str_pool_find(&ftree->names, name, strlen(name));
+
+    const fact_tree_node_t* last = NULL;
+
+    if(index)
+        *count = fact_tree_index_find_(index, name_id, found, max, &last);
+    else
+        *count = fact_tree_find_object_(ftree, ftree->root, name, name_id, found, max, &last);
+
+    return FACT_TREE_ERR_NONE;
+}
+
+// Every attribute narrows the ranges of leaves down, the
+// leaves themselves are only read as the query is
+fact_tree_err_t fact_tree_query(fact_tree_t* ftree, fact_tree_query_t* query, const fact_tree_attr_t* attrs, size_t size)
+{
+    utils_assert(ftree);
+    utils_assert(query);
+    utils_assert(attrs || !size);
+
+    memset(query, 0, sizeof(*query));
+
+    if(ftree->lazy.mode != FACT_TREE_LAZY_NONE)
+        return FACT_TREE_LAZY_ERR;
+
+    const fact_tree_attrs_t* index = fact_tree_attrs_(ftree);
+    index verified(return FACT_TREE_ALLOC_FAIL);
+
+    fact_tree_err_t err = fact_tree_query_start(query, index);
+
+    // with the index built every name of the tree is interned
+    for(size_t i = 0; i < size && err == FACT_TREE_ERR_NONE; ++i) {
+        uint32_t name_id = str_pool_find(&ftree->names, attrs[i].question, attrs[i].question_len);
+        err = fact_tree_query_and(query, name_id, attrs[i].yes);
+    }
+
+    if(err != FACT_TREE_ERR_NONE)
+        fact_tree_query_end(query);
+
+    return err;
+}
+
+fact_tree_err_t fact_tree_get_object_path(fact_tree_t* ftree, const fact_tree_node_t* node, fact_tree_path_t* path)
+{
+    utils_assert(ftree);
+    utils_assert(node);
+    utils_assert(path);
+
+    stack_ctor(path);
+
+    size_t depth = 0;
+    for(const fact_tree_node_t* cur = node; cur; cur = cur->parent)
+        ++depth;
+
+    // the parents are cached by the count, so the exact
+    // size is known before anything is pushed
+    if(stack_reserve(path, depth) != STACK_ERR_NONE)
+        return FACT_TREE_ALLOC_FAIL;
+
+    for( ; node; node = node->parent)
+        stack_push(path, node);
+
+    return FACT_TREE_ERR_NONE;
+}
+
+#define RENDER_INLINE_ 256
+
+// Popular objects are asked about over and over, their
+// definitions are rendered once and said from the cache
+fact_tree_err_t fact_tree_print_definition(fact_tree_t* ftree, const fact_tree_node_t* node)
+{
+    FACT_TREE_ASSERT_OK_(ftree);
+    utils_assert(node);
+
+    size_t len = 0;
+    const char* cached = def_cache_get(&ftree->defs, node, &len);
+
+    if(cached) {
+        fact_tree_say_(cached);
+        putc('\n', stdout);
+        return FACT_TREE_ERR_NONE;
+    }
+
+    // most definitions fit on the stack, longer ones are rendered again
+    char text_inline[RENDER_INLINE_] = "";
+    char* text = text_inline;
+
+    len = fact_tree_render_definition(node, text, sizeof(text_inline));
+
+    if(len >= sizeof(text_inline)) {
+        text = TYPED_CALLOC(len + 1, char);
+        text verified(return FACT_TREE_ALLOC_FAIL);
+
+        fact_tree_render_definition(node, text, len + 1);
+    }
+
+    fact_tree_say_(text);
+    putc('\n', stdout);
+
+    def_cache_put(&ftree->defs, node, text, len);
+
+    if(text != text_inline)
+        NFREE(text);
+
+    return FACT_TREE_ERR_NONE;
+}
+
+// Jumps are skew-binary: when the parent's jump and the one after it are
+// as long as each other, the node jumps over both, otherwise to its parent.
+// The parent must be linked
+static void fact_tree_node_link_one_(fact_tree_node_t* node)
+{
+    const fact_tree_node_t* parent = node->parent;
+    const fact_tree_node_t* jump   = parent->jump;
+
+    node->depth = parent->depth + 1;
+
+    if(jump && jump->jump && parent->depth - jump->depth == jump->depth - jump->jump->depth)
+        node->jump = jump->jump;
+    else
+        node->jump = parent;
+}
+
+// Links top and every built node under it in preorder, so parents go
+// before their children. The parent of top must be linked. The walk
+// climbs back up by parents and needs no stack, it cannot fail
+static void fact_tree_link_(fact_tree_node_t* top)
+{
+    fact_tree_node_t* node = top;
+
+    while(node) {
+        if(node->parent) {
+            fact_tree_node_link_one_(node);
+        }
+        else {
+            node->depth = 0;
+            node->jump  = NULL;
+        }
+
+        if(node->left) {
+            node = node->left;
+            continue;
+        }
+
+        if(node->right) {
+            node = node->right;
+            continue;
+        }
+
+        // up to the first node entered from the left of a question
+        while(node != top && (node == node->parent->right || !node->parent->right))
+            node = node->parent;
+
+        node = node != top ? node->parent->right : NULL;
+    }
+}
+
+// Ancestor of a linked node at the given depth
+static const fact_tree_node_t* fact_tree_node_lift_(const fact_tree_node_t* node, uint32_t depth)
+{
+    while(node->depth > depth)
+        node = node->jump->depth >= depth ? node->jump : node->parent;
+
+    return node;
+}
+
+const fact_tree_node_t* fact_tree_common_ancestor(const fact_tree_node_t* node_a, const fact_tree_node_t* node_b)
+{
+    utils_assert(node_a);
+    utils_assert(node_b);
+
+    if(node_a->depth > node_b->depth)
+        node_a = fact_tree_node_lift_(node_a, node_b->depth);
+    else
+        node_b = fact_tree_node_lift_(node_b, node_a->depth);
+
+    // jumps depend on the depth only, so nodes as deep
+    // as each other jump equally far
+    while(node_a != node_b) {
+        if(node_a->jump != node_b->jump) {
+            node_a = node_a->jump;
+            node_b = node_b->jump;
+        }
+        else {
+            node_a = node_a->parent;
+            node_b = node_b->parent;
+        }
+    }
+
+    return node_a;
+}
+
+// The tree is only verified, both paths are known to the nodes
+fact_tree_err_t fact_tree_print_difference(
+    __attribute__ ((unused)) fact_tree_t* ftree, 
+    const fact_tree_node_t* node_a, 
+    const fact_tree_node_t* node_b)
+{
+    FACT_TREE_ASSERT_OK_(ftree);
+    utils_assert(node_a);
+    utils_assert(node_b);
+
+    char text_inline[RENDER_INLINE_] = "";
+    char* text = text_inline;
+
+    size_t len = fact_tree_render_difference(node_a, node_b, text, sizeof(text_inline));
+
+    if(len >= sizeof(text_inline)) {
+        text = TYPED_CALLOC(len + 1, char);
+        text verified(return FACT_TREE_ALLOC_FAIL);
+
+        fact_tree_render_difference(node_a, node_b, text, len + 1);
+    }
+
+    fact_tree_say_(text);
+    puts("\n");
+
+    if(text != text_inline)
+        NFREE(text);
+
+    return FACT_TREE_ERR_NONE;
+}
+
+#undef RENDER_INLINE_
+#undef BUF_INITIAL_SIZE_
+
+#define PARALLEL_MIN_NODES_ (1ul << 16)
+#define WRITE_SPANS_PER_THREAD_ 8
+#define SPLIT_STACK_INIT_CAPACITY_ 64
+
+typedef struct fact_tree_split_frame_t
+{
+    fact_tree_node_t* node;
+    size_t size;
+    size_t spans_mark;
+    int children_done;
+} fact_tree_split_frame_t;
+
+// Splits the tree into the largest subtrees of at most max_size nodes,
+// in preorder. Subtrees smaller than min_size are left to the caller.
+// One postorder pass with an explicit stack: when a subtree fits, the
+// spans picked inside it are dropped in favour of the subtree itself
+static fact_tree_err_t fact_tree_split_nodes_(
+    fact_tree_t* ftree, 
+    size_t min_size,
+    size_t max_size,
+    fact_tree_node_t*** spans, 
+    size_t* spans_size)
+{
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    fact_tree_split_frame_t* frames = NULL;
+    size_t frames_size = 0, frames_capacity = 0, spans_capacity = 0;
+
+    *spans = NULL;
+    *spans_size = 0;
+
+    fact_tree_node_t* next = ftree->root;
+
+    while(next || frames_size) {
+        if(next) {
+            if(frames_size == frames_capacity) {
+                frames_capacity = frames_capacity ? frames_capacity * 2 : SPLIT_STACK_INIT_CAPACITY_;
+                fact_tree_split_frame_t* frames_new = (fact_tree_split_frame_t*) realloc(frames, frames_capacity * sizeof(frames[0]));
+                if(!frames_new) {
+                    err = FACT_TREE_ALLOC_FAIL;
+                    break;
+                }
+                frames = frames_new;
+            }
+
+            frames[frames_size++] = { .node = next, .size = 1, .spans_mark = *spans_size, .children_done = 0 };
+            next = NULL;
+            continue;
+        }
+
+        fact_tree_split_frame_t* top = &frames[frames_size - 1];
+
+        if(top->children_done < 2) {
+            // workers must find every node built
+            err = fact_tree_expand(ftree, top->node);
+            if(err != FACT_TREE_ERR_NONE)
+                break;
+
+            next = top->children_done++ ? top->node->right : top->node->left;
+            continue;
+        }
+
+        fact_tree_split_frame_t done = frames[--frames_size];
+
+        if(frames_size)
+            frames[frames_size - 1].size += done.size;
+
+        if(done.size > max_size)
+            continue;
+
+        *spans_size = done.spans_mark;
+
+        if(done.size < min_size)
+            continue;
+
+        if(*spans_size == spans_capacity) {
+            spans_capacity = spans_capacity ? spans_capacity * 2 : SPLIT_STACK_INIT_CAPACITY_;
+            fact_tree_node_t** spans_new = 
+                (fact_tree_node_t**) realloc(*spans, spans_capacity * sizeof(spans_new[0]));
+            if(!spans_new) {
+                err = FACT_TREE_ALLOC_FAIL;
+                break;
+            }
+            *spans = spans_new;
+        }
+
+        (*spans)[(*spans_size)++] = done.node;
+    }
+
+    NFREE(frames);
+
+    if(err != FACT_TREE_ERR_NONE) {
+        NFREE(*spans);
+        *spans_size = 0;
+    }
+
+    return err;
+}
+
+// Subtrees that already were serialized by workers
+// are copied in from parts when the walk reaches them
+typedef struct fact_tree_writer_t
+{
+    wbuf_t* wbuf;
+    size_t count;
+
+    fact_tree_node_t** spans;
+    wbuf_t* parts;
+    size_t* parts_count;
+    size_t spans_size;
+    size_t spans_next;
+} fact_tree_writer_t;
+
+// Serializes the tree into the file buffer of writer. Big trees are split
+// into spans of balanced size that are first serialized into memory
+// buffers in parallel, the output is the same as of the sequential walk
+static fact_tree_err_t fact_tree_fwrite_parallel_(fact_tree_t* ftree, fact_tree_writer_t* writer)
+{
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    if(threads > 1 && ftree->size >= PARALLEL_MIN_NODES_) {
+        size_t max_size = ftree->size / (size_t)(threads * WRITE_SPANS_PER_THREAD_);
+
+        err = fact_tree_split_nodes_(ftree, max_size / 8, max_size, &writer->spans, &writer->spans_size);
+        if(err != FACT_TREE_ERR_NONE)
+            return err;
+    }
+
+    if(writer->spans_size > 1) {
+        writer->parts       = TYPED_CALLOC(writer->spans_size, wbuf_t);
+        writer->parts_count = TYPED_CALLOC(writer->spans_size, size_t);
+
+        if(!writer->parts || !writer->parts_count) {
+            NFREE(writer->parts);
+            NFREE(writer->parts_count);
+            NFREE(writer->spans);
+            return FACT_TREE_ALLOC_FAIL;
+        }
+
+        // every node was built by the split, so workers never expand lazy nodes
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for(size_t i = 0; i < writer->spans_size; ++i) {
+            fact_tree_writer_t worker = {
+                .wbuf        = &writer->parts[i],
+                .count       = 0,
+                .spans       = NULL,
+                .parts       = NULL,
+                .parts_count = NULL,
+                .spans_size  = 0,
+                .spans_next  = 0
+            };
+
+            if(wbuf_open_mem(worker.wbuf) == WBUF_ERR_NONE)
+                fact_tree_fwrite_node_(ftree, writer->spans[i], &worker);
+
+            writer->parts_count[i] = worker.count;
+        }
+
+        for(size_t i = 0; i < writer->spans_size; ++i)
+            if(writer->parts[i].err != WBUF_ERR_NONE)
+                err = FACT_TREE_ALLOC_FAIL;
+    }
+    else
+        writer->spans_size = 0;
+
+    if(err == FACT_TREE_ERR_NONE)
+        fact_tree_fwrite_node_(ftree, ftree->root, writer);
+
+    for(size_t i = 0; writer->parts && i < writer->spans_size; ++i)
+        wbuf_free(&writer->parts[i]);
+
+    NFREE(writer->parts);
+    NFREE(writer->parts_count);
+    NFREE(writer->spans);
+
+    UTILS_LOGD(LOG_CATEGORY_FTREE, "serialized on %d threads, %zu subtree spans", threads, writer->spans_size);
+
+    return err;
+}
+
+#undef PARALLEL_MIN_NODES_
+#undef WRITE_SPANS_PER_THREAD_
+#undef SPLIT_STACK_INIT_CAPACITY_
+
+// The database is replaced only after the new one is fully on disk,
+// a crash in the middle of a save leaves the old file intact
+fact_tree_err_t fact_tree_fwrite(fact_tree_t* fact_tree, const char* filename)
+{
+    utils_assert(filename);
+
+    wbuf_t wbuf = {};
+
+    wbuf_err_t wbuf_err = wbuf_open(&wbuf, filename);
+    if(wbuf_err != WBUF_ERR_NONE) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: %s: %s", filename, wbuf_strerr(wbuf_err), strerror(errno));
+        return wbuf_err == WBUF_ALLOC_FAIL ? FACT_TREE_ALLOC_FAIL : FACT_TREE_IO_ERR;
+    }
+
+    stopwatch_t stopwatch = {};
+    stopwatch_start(&stopwatch);
+
+    fact_tree_writer_t writer = {
+        .wbuf        = &wbuf,
+        .count       = 0,
+        .spans       = NULL,
+        .parts       = NULL,
+        .parts_count = NULL,
+        .spans_size  = 0,
+        .spans_next  = 0
+    };
+
+    fact_tree_err_t err = fact_tree_fwrite_parallel_(fact_tree, &writer);
+    if(err != FACT_TREE_ERR_NONE)
+        wbuf.err = WBUF_ALLOC_FAIL;
+
+    // on error the temporary file is dropped by commit
+    wbuf_err = wbuf_commit(&wbuf);
+    if(wbuf_err != WBUF_ERR_NONE) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: %s: %s", filename, wbuf_strerr(wbuf_err), strerror(errno));
+        return err != FACT_TREE_ERR_NONE ? err : FACT_TREE_IO_ERR;
+    }
+
+    double elapsed_s = stopwatch_s(&stopwatch);
+
+    UTILS_LOGD(
+        LOG_CATEGORY_FTREE, 
+        "%s: wrote %zu nodes, %lu bytes in %.3f ms (%.1f MB/s, %.1f ms per million nodes)", 
+        filename, 
+        writer.count, 
+        wbuf.written, 
+        elapsed_s * 1e3,
+        (double) wbuf.written / elapsed_s / 1e6,
+        writer.count ? elapsed_s * 1e9 / (double) writer.count : 0.0
+    );
+
+    return fact_tree_journal_saved_(fact_tree, filename, 0);
+}
+
+// Subtrees written ahead by parallel workers are copied as they are
+static int fact_tree_fwrite_part_(fact_tree_writer_t* writer, const fact_tree_node_t* node)
+{
+    if(writer->spans_next >= writer->spans_size || writer->spans[writer->spans_next] != node)
+        return 0;
+
+    const wbuf_t* part = &writer->parts[writer->spans_next];
+
+    wbuf_put(writer->wbuf, part->data, part->size);
+    writer->count += writer->parts_count[writer->spans_next++];
+
+    return 1;
+}
+
+// Write errors are kept in wbuf and reported by wbuf_commit
+void fact_tree_fwrite_node_(fact_tree_t* ftree, fact_tree_node_t* node, fact_tree_writer_t* writer)
+{
+    utils_assert(node);
+    utils_assert(writer);
+
+    wbuf_t* wbuf = writer->wbuf;
+
+    fact_tree_walk_t walk;
+    fact_tree_walk_begin(
+        &walk, 
+        ftree, 
+        node, 
+        FACT_TREE_WALK_PRE | FACT_TREE_WALK_IN | FACT_TREE_WALK_POST | FACT_TREE_WALK_LEAF
+    );
+
+    while(fact_tree_walk_next(&walk)) {
+        fact_tree_node_t* cur = walk.node;
+
+        switch(walk.event) {
+            case FACT_TREE_WALK_LEAF:
+                if(fact_tree_fwrite_part_(writer, cur))
+                    break;
+
+                WBUF_PUT_LITERAL(wbuf, "( \"");
+                wbuf_put(wbuf, fact_tree_node_name(cur), cur->name_len);
+                WBUF_PUT_LITERAL(wbuf, "\" " NIL_STR " " NIL_STR " )");
+
+                ++writer->count;
+                break;
+
+            case FACT_TREE_WALK_PRE:
+                if(fact_tree_fwrite_part_(writer, cur)) {
+                    fact_tree_walk_skip(&walk);
+                    break;
+                }
+
+                WBUF_PUT_LITERAL(wbuf, "( \"");
+                wbuf_put(wbuf, fact_tree_node_name(cur), cur->name_len);
+                WBUF_PUT_LITERAL(wbuf, "\" ");
+
+                if(!cur->left)
+                    WBUF_PUT_LITERAL(wbuf, NIL_STR);
+                break;
+
+            case FACT_TREE_WALK_IN:
+                if(!cur->right)
+                    WBUF_PUT_LITERAL(wbuf, " " NIL_STR " ");
+                break;
+
+            case FACT_TREE_WALK_POST:
+            default:
+                WBUF_PUT_LITERAL(wbuf, ")");
+                ++writer->count;
+                break;
+        }
+    }
+
+    // a subtree that could not be read fails the write like the file would
+    fact_tree_err_t err = fact_tree_walk_end(&walk);
+    if(err != FACT_TREE_ERR_NONE && wbuf->err == WBUF_ERR_NONE)
+        wbuf->err = err == FACT_TREE_ALLOC_FAIL ? WBUF_ALLOC_FAIL : WBUF_IO_ERR;
+}
+
+fact_tree_err_t fact_tree_fwrite_bin(fact_tree_t* ftree, const char* filename)
+{
+    FACT_TREE_ASSERT_OK_(ftree);
+    utils_assert(filename);
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    fact_tree_node_t** order = NULL;
+    fact_tree_soa_link_t* links = NULL;
+    fact_tree_bin_node_t* records = NULL;
+    size_t count = 0;
+
+    fact_tree_bin_header_t header = {
+        .magic       = {},
+        .version     = FACT_TREE_BIN_VERSION,
+        .node_count  = 0,
+        .strtab_size = 0
+    };
+    memcpy(header.magic, FACT_TREE_BIN_MAGIC, sizeof(header.magic));
+
+    BEGIN {
+        // any order with parents ahead of children is valid,
+        // a file in layout order loads straight into it
+        err = fact_tree_layout_order(ftree, ftree->layout, &order, &links, &count);
+
+        if(err == FACT_TREE_FORMAT_ERR)
+            UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: tree is too large for binary format", filename);
+
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        records = TYPED_CALLOC(count ? count : 1, fact_tree_bin_node_t);
+        if(!records) {
+            err = FACT_TREE_ALLOC_FAIL;
+            GOTO_END;
+        }
+
+        for(size_t i = 0; i < count; ++i) {
+            const fact_tree_node_t* node = order[i];
+            fact_tree_bin_node_t* rec = &records[i];
+
+            if(node->name_len > UINT32_MAX) {
+                UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: tree is too large for binary format", filename);
+                err = FACT_TREE_FORMAT_ERR;
+                break;
+            }
+
+            rec->name_off = header.strtab_size;
+            rec->name_len = (uint32_t) node->name_len;
+            header.strtab_size += node->name_len;
+
+            static_assert(FACT_TREE_SOA_NIL == FACT_TREE_BIN_NIL, "links are stored in records as is");
+
+            rec->left   = links[i].left;
+            rec->right  = links[i].right;
+            rec->parent = links[i].parent;
+        }
+
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        header.node_count = (uint32_t) count;
+
+        wbuf_t wbuf = {};
+
+        wbuf_err_t wbuf_err = wbuf_open(&wbuf, filename);
+
+        if(wbuf_err == WBUF_ERR_NONE) {
+            wbuf_put(&wbuf, &header, sizeof(header));
+            wbuf_put(&wbuf, records, count * sizeof(records[0]));
+
+            for(size_t i = 0; i < count; ++i)
+                wbuf_put(&wbuf, fact_tree_node_name(order[i]), order[i]->name_len);
+
+            wbuf_err = wbuf_commit(&wbuf);
+        }
+
+        if(wbuf_err != WBUF_ERR_NONE) {
+            UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: %s: %s", filename, wbuf_strerr(wbuf_err), strerror(errno));
+            err = wbuf_err == WBUF_ALLOC_FAIL ? FACT_TREE_ALLOC_FAIL : FACT_TREE_IO_ERR;
+            GOTO_END;
+        }
+
+        err = fact_tree_journal_saved_(ftree, filename, 1);
+
+    } END;
+
+    NFREE(order);
+    NFREE(links);
+    NFREE(records);
+
+    return err;
+}
+
+int fact_tree_name_equals_(const fact_tree_node_t* node, const char* str, size_t len)
+{
+    utils_assert(str);
+
+    return len == node->name_len && memcmp(fact_tree_node_name(node), str, len) == 0;
+}
+
+// Subtree occupying [begin, end) of the text buffer
+typedef struct fact_tree_subtree_t
+{
+    size_t begin;
+    size_t end;
+    fact_tree_node_t* root;
+    size_t size;
+
+    // root once it is linked into the tree
+    fact_tree_node_t* attached;
+} fact_tree_subtree_t;
+
+// Parser state over one span of the text buffer. Subtrees listed in
+// subtrees were already parsed by workers and get linked in as is
+typedef struct fact_tree_parser_t
+{
+    const char* fname;
+    char* buf;
+    size_t len;
+
+    arena_t* arena;
+
+    size_t cursor;
+    size_t tok_pos;
+    size_t size;
+
+    fact_tree_subtree_t* subtrees;
+    size_t subtrees_size;
+    size_t subtrees_next;
+} fact_tree_parser_t;
+
+static void fact_tree_parser_syntax_err_(fact_tree_parser_t* parser, const char* expc)
+{
+    // workers of the parallel parse have no file name, their
+    // errors are reported again by the sequential parse
+    if(!parser->fname)
+        return;
+
+    UTILS_LOGE(
+        LOG_CATEGORY_FTREE, 
+        "%s:1:%zu: syntax error: unexpected symbol <%c>, expected <%s>", 
+        parser->fname, 
+        parser->tok_pos, 
+        parser->buf[parser->tok_pos],
+        expc
+    );
+}
+
+static scan_token_t fact_tree_parser_next_token_(fact_tree_parser_t* parser)
+{
+    utils_assert(parser);
+
+    scan_token_t tok = scan_next_token(parser->buf, parser->len, parser->cursor);
+
+    parser->cursor = tok.pos + tok.len;
+
+    // tok_pos points at the token being parsed, for error reporting and dumps
+    parser->tok_pos = tok.pos < parser->len ? tok.pos : parser->len - 1;
+
+    return tok;
+}
+
+#define PARSE_STACK_INIT_CAPACITY_ 64
+
+typedef struct fact_tree_parse_frame_t
+{
+    fact_tree_node_t* node;
+    int children_read;
+} fact_tree_parse_frame_t;
+
+static fact_tree_err_t fact_tree_parse_frame_push_(
+    fact_tree_parse_frame_t** frames, 
+    size_t* size, 
+    size_t* capacity, 
+    fact_tree_node_t* node)
+{
+    if(*size == *capacity) {
+        size_t capacity_new = *capacity ? *capacity * 2 : PARSE_STACK_INIT_CAPACITY_;
+
+        fact_tree_parse_frame_t* frames_new = 
+            (fact_tree_parse_frame_t*) realloc(*frames, capacity_new * sizeof(frames_new[0]));
+        frames_new verified(return FACT_TREE_ALLOC_FAIL);
+
+        *frames   = frames_new;
+        *capacity = capacity_new;
+    }
+
+    (*frames)[(*size)++] = { .node = node, .children_read = 0 };
+
+    return FACT_TREE_ERR_NONE;
+}
+
+// Parses ( "name" left right ) with an explicit stack of open nodes,
+// so the depth of the tree is bounded by memory instead of call stack.
+// Every node is linked into the tree as soon as it is opened, so on error
+// the partially read tree is still consistent and can be freed as a whole.
+// Reads exactly one node or nil starting at parser->cursor.
+static fact_tree_err_t fact_tree_parse_(fact_tree_parser_t* parser, fact_tree_node_t** node)
+{
+    utils_assert(parser);
+    utils_assert(node);
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    fact_tree_parse_frame_t* frames = NULL;
+    size_t frames_size = 0, frames_capacity = 0;
+
+    *node = NULL;
+
+    do {
+        fact_tree_parse_frame_t* top = frames_size ? &frames[frames_size - 1] : NULL;
+
+        scan_token_t tok = fact_tree_parser_next_token_(parser);
+
+        if(top && top->children_read == 2) {
+            if(tok.kind != SCAN_TOKEN_CLOSE) {
+                fact_tree_parser_syntax_err_(parser, ")");
+                err = FACT_TREE_SYNTAX_ERR;
+                break;
+            }
+
+            --frames_size;
+            continue;
+        }
+
+        fact_tree_node_t** child = node;
+        if(top)
+            child = top->children_read++ ? &top->node->right : &top->node->left;
+
+        if(tok.kind == SCAN_TOKEN_OPEN 
+                && parser->subtrees_next < parser->subtrees_size
+                && parser->subtrees[parser->subtrees_next].begin == tok.pos) {
+            fact_tree_subtree_t* subtree = &parser->subtrees[parser->subtrees_next++];
+
+            *child = subtree->root;
+            if(top)
+                (*child)->parent = top->node;
+
+            subtree->attached = subtree->root;
+            subtree->root     = NULL;
+            parser->cursor    = subtree->end;
+        }
+        else if(tok.kind == SCAN_TOKEN_OPEN) {
+            utils_str_t name = { .str = NULL, .len = 0 };
+            err = fact_tree_allocate_new_node_(parser->arena, child, name);
+            if(err != FACT_TREE_ERR_NONE)
+                break;
+
+            parser->size++;
+
+            if(top) {
+                (*child)->parent = top->node;
+                fact_tree_node_link_one_(*child);
+            }
+
+            tok = fact_tree_parser_next_token_(parser);
+
+            if(tok.kind != SCAN_TOKEN_STRING) {
+                fact_tree_parser_syntax_err_(parser, "\"");
+                err = FACT_TREE_SYNTAX_ERR;
+                break;
+            }
+
+            fact_tree_set_name_(*child, parser->buf + tok.pos + 1, tok.len - 2);
+
+            err = fact_tree_parse_frame_push_(&frames, &frames_size, &frames_capacity, *child);
+            if(err != FACT_TREE_ERR_NONE)
+                break;
+        }
+        else if(tok.kind == SCAN_TOKEN_NIL) {
+            *child = NULL;
+        }
+        else {
+            fact_tree_parser_syntax_err_(parser, "(");
+            err = FACT_TREE_SYNTAX_ERR;
+            break;
+        }
+
+    } while(frames_size);
+
+    NFREE(frames);
+
+    return err;
+}
+
+#undef PARSE_STACK_INIT_CAPACITY_
+
+#define PARALLEL_MIN_BUF_SIZE_ (4l << 20)
+#define PARALLEL_SPANS_PER_THREAD_ 8
+
+// Picks the largest subtrees not longer than max_len bytes, in file order.
+// Subtrees shorter than min_len are left to the sequential parse.
+// Returns 0 if parentheses in the index are unbalanced.
+static int fact_tree_split_spans_(
+    const char* buf, 
+    const scan_index_t* index, 
+    size_t min_len,
+    size_t max_len,
+    fact_tree_subtree_t** spans, 
+    size_t* spans_size)
+{
+    size_t* opened = TYPED_CALLOC(index->size / 2 + 1, size_t);
+    *spans = TYPED_CALLOC(index->size / 2 + 1, fact_tree_subtree_t);
+
+    if(!opened || !*spans) {
+        NFREE(opened);
+        NFREE(*spans);
+        return 0;
+    }
+
+    size_t opened_size = 0;
+    *spans_size = 0;
+
+    int balanced = 1;
+
+    for(size_t i = 0; i < index->size; ++i) {
+        size_t off = index->offs[i];
+
+        if(buf[off] == '(') {
+            if(opened_size == index->size / 2 + 1) {
+                balanced = 0;
+                break;
+            }
+            opened[opened_size++] = off;
+            continue;
+        }
+
+        if(opened_size == 0) {
+            balanced = 0;
+            break;
+        }
+
+        size_t begin = opened[--opened_size];
+        size_t end   = off + 1;
+
+        if(end - begin > max_len)
+            continue;
+
+        // children were picked before their parent was closed
+        while(*spans_size && (*spans)[*spans_size - 1].begin > begin)
+            --*spans_size;
+
+        if(end - begin >= min_len)
+            (*spans)[(*spans_size)++] = { .begin = begin, .end = end, .root = NULL, .size = 0, .attached = NULL };
+    }
+
+    NFREE(opened);
+
+    return balanced && opened_size == 0;
+}
+
+// Stage one indexes parentheses outside of names, stage two parses
+// balanced subtree spans on all threads and the sequential parse
+// of the remaining top of the tree links them in by their offsets.
+// Falls back to a plain sequential parse for small or malformed input,
+// so that syntax errors are reported exactly as before.
+fact_tree_err_t fact_tree_fread_text_(fact_tree_t* ftree, const char* fname)
+{
+    FACT_TREE_ASSERT_OK_(ftree);
+
+    fact_tree_parser_t parser = {
+        .fname          = fname,
+        .buf            = ftree->buf.ptr,
+        .len            = (size_t) ftree->buf.len,
+        .arena          = &ftree->arena,
+        .cursor         = 0,
+        .tok_pos        = 0,
+        .size           = 0,
+        .subtrees       = NULL,
+        .subtrees_size  = 0,
+        .subtrees_next  = 0
+    };
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    scan_index_t index = { .offs = NULL, .size = 0, .capacity = 0 };
+    fact_tree_subtree_t* spans = NULL;
+    size_t spans_size = 0;
+
+    if(threads > 1 && ftree->buf.len >= PARALLEL_MIN_BUF_SIZE_
+            && scan_build_index(parser.buf, parser.len, &index) == 0) {
+        size_t max_len = parser.len / (size_t) (threads * PARALLEL_SPANS_PER_THREAD_);
+
+        if(!fact_tree_split_spans_(parser.buf, &index, max_len / 8, max_len, &spans, &spans_size))
+            spans_size = 0;
+    }
+
+    scan_index_dtor(&index);
+
+    // workers allocate from arenas of their own, merged into the tree after the parse
+    arena_t* arenas = NULL;
+
+    if(spans_size > 1) {
+        arenas = TYPED_CALLOC((size_t) threads, arena_t);
+        if(!arenas)
+            spans_size = 0;
+    }
+
+    if(spans_size > 1) {
+        int span_failed = 0;
+
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for(size_t i = 0; i < spans_size; ++i) {
+            fact_tree_parser_t worker = parser;
+            worker.fname  = NULL;
+            worker.cursor = spans[i].begin;
+#ifdef _OPENMP
+            worker.arena  = &arenas[omp_get_thread_num()];
+#endif
+
+            fact_tree_err_t worker_err = fact_tree_parse_(&worker, &spans[i].root);
+            spans[i].size = worker.size;
+
+            if(worker_err != FACT_TREE_ERR_NONE) {
+#ifdef _OPENMP
+                #pragma omp atomic write
+#endif
+                span_failed = 1;
+            }
+        }
+
+        for(int i = 0; i < threads; ++i)
+            arena_merge(&ftree->arena, &arenas[i]);
+
+        // the first error in the file may be in no span at all or in a
+        // span after the one that failed, so the whole file is parsed
+        // again in order and the error is reported where it really is
+        if(span_failed) {
+            UTILS_LOGD(LOG_CATEGORY_FTREE, "%s: a subtree span failed to parse, parsing sequentially", fname);
+        }
+        else {
+            for(size_t i = 0; i < spans_size; ++i)
+                parser.size += spans[i].size;
+
+            parser.subtrees      = spans;
+            parser.subtrees_size = spans_size;
+        }
+    }
+
+    err = fact_tree_parse_(&parser, &ftree->root);
+
+    // workers counted depths from the roots of their spans, the spans
+    // are disjoint and are linked again from where they hang now
+    if(err == FACT_TREE_ERR_NONE) {
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for(size_t i = 0; i < parser.subtrees_size; ++i)
+            if(spans[i].attached)
+                fact_tree_link_(spans[i].attached);
+    }
+
+    // spans that were not linked in stay in the arena until the tree is freed
+    for(size_t i = 0; i < parser.subtrees_size; ++i)
+        if(spans[i].root)
+            parser.size -= spans[i].size;
+
+    NFREE(spans);
+    NFREE(arenas);
+
+    ftree->size   += parser.size;
+    ftree->buf.pos = (ssize_t) parser.tok_pos;
+
+    UTILS_LOGD(LOG_CATEGORY_FTREE, "%s: parsed on %d threads, %zu subtree spans", fname, threads, spans_size);
+
+    return err;
+}
+
+#undef PARALLEL_MIN_BUF_SIZE_
+#undef PARALLEL_SPANS_PER_THREAD_
+
+int fact_tree_buf_is_bin_(fact_tree_t* ftree)
+{
+    return ftree->buf.len >= (ssize_t) sizeof(fact_tree_bin_header_t)
+        && memcmp(ftree->buf.ptr, FACT_TREE_BIN_MAGIC, sizeof(FACT_TREE_BIN_MAGIC) - 1) == 0;
+}
+
+static const fact_tree_bin_node_t* fact_tree_bin_records_(fact_tree_t* ftree)
+{
+    return (const fact_tree_bin_node_t*)(ftree->buf.ptr + sizeof(fact_tree_bin_header_t));
+}
+
+// Children follow their parent and point back to it, so checking
+// both directions on every record rules out cycles and sharing
+static int fact_tree_bin_record_valid_(fact_tree_t* ftree, uint32_t i)
+{
+    const fact_tree_bin_header_t* header = (const fact_tree_bin_header_t*) ftree->buf.ptr;
+    const fact_tree_bin_node_t* records  = fact_tree_bin_records_(ftree);
+
+    uint32_t node_count = header->node_count;
+    const fact_tree_bin_node_t* rec = &records[i];
+
+    int valid = rec->name_off <= header->strtab_size 
+             && rec->name_len <= header->strtab_size - rec->name_off;
+
+    if(rec->left != FACT_TREE_BIN_NIL)
+        valid = valid && rec->left > i && rec->left < node_count 
+                      && records[rec->left].parent == i;
+
+    if(rec->right != FACT_TREE_BIN_NIL)
+        valid = valid && rec->right > i && rec->right < node_count 
+                      && records[rec->right].parent == i
+                      && rec->right != rec->left;
+
+    if(i == 0)
+        valid = valid && rec->parent == FACT_TREE_BIN_NIL;
+    else
+        valid = valid && rec->parent < i 
+                      && (records[rec->parent].left == i || records[rec->parent].right == i);
+
+    return valid;
+}
+
+static fact_tree_err_t fact_tree_bin_node_(fact_tree_t* ftree, const char* fname, uint32_t i, fact_tree_node_t** node)
+{
+    const fact_tree_bin_header_t* header = (const fact_tree_bin_header_t*) ftree->buf.ptr;
+    const fact_tree_bin_node_t* rec = &fact_tree_bin_records_(ftree)[i];
+
+    if(!fact_tree_bin_record_valid_(ftree, i)) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: invalid node record %u", fname, i);
+        return FACT_TREE_FORMAT_ERR;
+    }
+
+    char* strtab = ftree->buf.ptr + sizeof(*header) + header->node_count * sizeof(*rec);
+
+    utils_str_t name = { .str = strtab + rec->name_off, .len = rec->name_len };
+
+    return fact_tree_allocate_new_node_(&ftree->arena, node, name);
+}
+
+// In lazy mode only the root record is checked and built,
+// the rest is done record by record in fact_tree_expand
+fact_tree_err_t fact_tree_fread_bin_(fact_tree_t* ftree, const char* fname, int lazy)
+{
+    FACT_TREE_ASSERT_OK_(ftree);
+    utils_assert(fname);
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    const fact_tree_bin_header_t* header = (const fact_tree_bin_header_t*) ftree->buf.ptr;
+
+    if(header->version != FACT_TREE_BIN_VERSION) {
+        UTILS_LOGE(
+            LOG_CATEGORY_FTREE, "%s: unsupported binary version %u, expected %u", 
+            fname, header->version, FACT_TREE_BIN_VERSION
+        );
+        return FACT_TREE_FORMAT_ERR;
+    }
+
+    uint64_t node_count   = header->node_count;
+    uint64_t records_size = node_count * sizeof(fact_tree_bin_node_t);
+    uint64_t file_size    = (uint64_t) ftree->buf.len - sizeof(*header);
+
+    if(records_size > file_size || file_size - records_size != header->strtab_size) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: file size does not match header", fname);
+        return FACT_TREE_FORMAT_ERR;
+    }
+
+    const fact_tree_bin_node_t* records = fact_tree_bin_records_(ftree);
+
+    if(lazy) {
+        if(node_count == 0)
+            return FACT_TREE_ERR_NONE;
+
+        err = fact_tree_bin_node_(ftree, fname, 0, &ftree->root);
+        if(err != FACT_TREE_ERR_NONE)
+            return err;
+
+        ftree->root->lazy    = 1;
+        ftree->root->lazy_id = 0;
+        ftree->lazy.mode     = FACT_TREE_LAZY_BIN;
+        ftree->size          = node_count;
+
+        return FACT_TREE_ERR_NONE;
+    }
+
+    fact_tree_node_t** nodes = TYPED_CALLOC(node_count, fact_tree_node_t*);
+    if(node_count && !nodes)
+        return FACT_TREE_ALLOC_FAIL;
+
+    for(uint32_t i = 0; i < node_count; ++i) {
+        const fact_tree_bin_node_t* rec = &records[i];
+
+        err = fact_tree_bin_node_(ftree, fname, i, &nodes[i]);
+        if(err != FACT_TREE_ERR_NONE)
+            break;
+
+        ftree->size++;
+
+        if(i == 0) {
+            ftree->root = nodes[i];
+            continue;
+        }
+
+        fact_tree_node_t* parent = nodes[rec->parent];
+        nodes[i]->parent = parent;
+
+        // parents have smaller numbers and are linked already
+        fact_tree_node_link_one_(nodes[i]);
+
+        if(records[rec->parent].left == i)
+            parent->left = nodes[i];
+        else
+            parent->right = nodes[i];
+    }
+
+    NFREE(nodes);
+
+    return err;
+}
+
+static fact_tree_parser_t fact_tree_lazy_parser_(fact_tree_t* ftree)
+{
+    fact_tree_parser_t parser = {
+        .fname          = ftree->lazy.fname,
+        .buf            = ftree->buf.ptr,
+        .len            = (size_t) ftree->buf.len,
+        .arena          = &ftree->arena,
+        .cursor         = 0,
+        .tok_pos        = 0,
+        .size           = 0,
+        .subtrees       = NULL,
+        .subtrees_size  = 0,
+        .subtrees_next  = 0
+    };
+
+    return parser;
+}
+
+// Builds node number id of the subtree index without its children
+static fact_tree_err_t fact_tree_lazy_text_node_(fact_tree_t* ftree, fact_tree_parser_t* parser, size_t id, fact_tree_node_t** node)
+{
+    parser->cursor = ftree->lazy.begin[id] + 1;
+
+    scan_token_t tok = fact_tree_parser_next_token_(parser);
+
+    if(tok.kind != SCAN_TOKEN_STRING) {
+        fact_tree_parser_syntax_err_(parser, "\"");
+        return FACT_TREE_SYNTAX_ERR;
+    }
+
+    utils_str_t name = { .str = parser->buf + tok.pos + 1, .len = tok.len - 2 };
+
+    fact_tree_err_t err = fact_tree_allocate_new_node_(&ftree->arena, node, name);
+    if(err != FACT_TREE_ERR_NONE)
+        return err;
+
+    (*node)->lazy    = 1;
+    (*node)->lazy_id = id;
+
+    return FACT_TREE_ERR_NONE;
+}
+
+// Only the index is built up front: one pass over parentheses
+// matches every node with the end of its span. Input that does
+// not split into balanced spans is parsed eagerly instead, so
+// that its errors are reported the same way
+fact_tree_err_t fact_tree_fread_text_lazy_(fact_tree_t* ftree, const char* fname)
+{
+    FACT_TREE_ASSERT_OK_(ftree);
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    scan_index_t index = { .offs = NULL, .size = 0, .capacity = 0 };
+
+    if(scan_build_index(ftree->buf.ptr, (size_t) ftree->buf.len, &index) != 0)
+        return FACT_TREE_ALLOC_FAIL;
+
+    size_t nodes_max = index.size / 2 + 1;
+
+    size_t* opened = TYPED_CALLOC(nodes_max, size_t);
+    ftree->lazy.begin = TYPED_CALLOC(nodes_max, size_t);
+    ftree->lazy.end   = TYPED_CALLOC(nodes_max, size_t);
+
+    size_t opened_size = 0;
+    int balanced = 1;
+
+    BEGIN {
+        if(!opened || !ftree->lazy.begin || !ftree->lazy.end) {
+            err = FACT_TREE_ALLOC_FAIL;
+            GOTO_END;
+        }
+
+        for(size_t i = 0; balanced && i < index.size; ++i) {
+            size_t off = index.offs[i];
+
+            if(ftree->buf.ptr[off] == '(') {
+                balanced = ftree->lazy.size < nodes_max;
+                if(balanced) {
+                    ftree->lazy.begin[ftree->lazy.size] = off;
+                    opened[opened_size++] = ftree->lazy.size++;
+                }
+            }
+            else {
+                balanced = opened_size > 0;
+                if(balanced)
+                    ftree->lazy.end[opened[--opened_size]] = off + 1;
+            }
+        }
+
+        if(!balanced || opened_size || ftree->lazy.size == 0) {
+            UTILS_LOGD(LOG_CATEGORY_FTREE, "%s: no subtree index, loading eagerly", fname);
+
+            NFREE(ftree->lazy.begin);
+            NFREE(ftree->lazy.end);
+            ftree->lazy.size = 0;
+
+            err = fact_tree_fread_text_(ftree, fname);
+            GOTO_END;
+        }
+
+        fact_tree_parser_t parser = fact_tree_lazy_parser_(ftree);
+
+        err = fact_tree_lazy_text_node_(ftree, &parser, 0, &ftree->root);
+        ftree->buf.pos = (ssize_t) parser.tok_pos;
+
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        ftree->lazy.mode = FACT_TREE_LAZY_TEXT;
+        ftree->size      = ftree->lazy.size;
+
+    } END;
+
+    NFREE(opened);
+    scan_index_dtor(&index);
+
+    return err;
+}
+
+// Number of the node whose span starts at off, spans are sorted by begin
+static int fact_tree_lazy_find_id_(fact_tree_t* ftree, size_t off, size_t* id)
+{
+    size_t lo = 0, hi = ftree->lazy.size;
+
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(ftree->lazy.begin[mid] < off)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *id = lo;
+
+    return lo < ftree->lazy.size && ftree->lazy.begin[lo] == off;
+}
+
+static fact_tree_err_t fact_tree_expand_text_(fact_tree_t* ftree, fact_tree_node_t* node)
+{
+    fact_tree_parser_t parser = fact_tree_lazy_parser_(ftree);
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    // name was checked when the node was built
+    parser.cursor = ftree->lazy.begin[node->lazy_id] + 1;
+    fact_tree_parser_next_token_(&parser);
+
+    fact_tree_node_t** children[] = { &node->left, &node->right };
+
+    for(size_t i = 0; i < SIZEOF(children); ++i) {
+        scan_token_t tok = fact_tree_parser_next_token_(&parser);
+
+        if(tok.kind == SCAN_TOKEN_NIL)
+            continue;
+
+        size_t id = 0;
+        if(tok.kind != SCAN_TOKEN_OPEN || !fact_tree_lazy_find_id_(ftree, tok.pos, &id)) {
+            fact_tree_parser_syntax_err_(&parser, "(");
+            err = FACT_TREE_SYNTAX_ERR;
+            break;
+        }
+
+        err = fact_tree_lazy_text_node_(ftree, &parser, id, children[i]);
+        if(err != FACT_TREE_ERR_NONE)
+            break;
+
+        (*children[i])->parent = node;
+
+        parser.cursor = ftree->lazy.end[id];
+    }
+
+    if(err == FACT_TREE_ERR_NONE && fact_tree_parser_next_token_(&parser).kind != SCAN_TOKEN_CLOSE) {
+        fact_tree_parser_syntax_err_(&parser, ")");
+        err = FACT_TREE_SYNTAX_ERR;
+    }
+
+    ftree->buf.pos = (ssize_t) parser.tok_pos;
+
+    return err;
+}
+
+static fact_tree_err_t fact_tree_expand_bin_(fact_tree_t* ftree, fact_tree_node_t* node)
+{
+    const fact_tree_bin_node_t* rec = &fact_tree_bin_records_(ftree)[node->lazy_id];
+
+    uint32_t ids[] = { rec->left, rec->right };
+    fact_tree_node_t** children[] = { &node->left, &node->right };
+
+    for(size_t i = 0; i < SIZEOF(children); ++i) {
+        if(ids[i] == FACT_TREE_BIN_NIL)
+            continue;
+
+        fact_tree_err_t err = fact_tree_bin_node_(ftree, ftree->lazy.fname, ids[i], children[i]);
+        if(err != FACT_TREE_ERR_NONE)
+            return err;
+
+        (*children[i])->lazy    = 1;
+        (*children[i])->lazy_id = ids[i];
+        (*children[i])->parent  = node;
+    }
+
+    return FACT_TREE_ERR_NONE;
+}
+
+fact_tree_err_t fact_tree_expand(fact_tree_t* ftree, fact_tree_node_t* node)
+{
+    utils_assert(ftree);
+    utils_assert(node);
+
+    if(!node->lazy)
+        return FACT_TREE_ERR_NONE;
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    switch(ftree->lazy.mode) {
+        case FACT_TREE_LAZY_TEXT:
+            err = fact_tree_expand_text_(ftree, node);
+            break;
+        case FACT_TREE_LAZY_BIN:
+            err = fact_tree_expand_bin_(ftree, node);
+            break;
+        case FACT_TREE_LAZY_PAGED:
+            err = fact_tree_pages_expand(ftree, node);
+            break;
+        case FACT_TREE_LAZY_NONE:
+        default:
+            utils_assert(0 && "lazy node in an eagerly loaded tree");
+            break;
+    }
+
+    // the node stays lazy, so it is never taken for a leaf:
+    // callers fail and the next one tries the file again
+    if(err != FACT_TREE_ERR_NONE) {
+        node->left  = NULL;
+        node->right = NULL;
+
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: children of <%.*s> cannot be built: %s", 
+                   ftree->lazy.fname, (int) node->name_len, fact_tree_node_name(node), fact_tree_strerr(err));
+
+        FACT_TREE_DUMP(ftree, err);
+        return err;
+    }
+
+    node->lazy = 0;
+
+    if(node->left)
+        fact_tree_node_link_one_(node->left);
+
+    if(node->right)
+        fact_tree_node_link_one_(node->right);
+
+    return FACT_TREE_ERR_NONE;
+}
+
+fact_tree_node_t* fact_tree_node_left(fact_tree_t* ftree, fact_tree_node_t* node)
+{
+    utils_assert(node);
+
+    if(node->lazy)
+        fact_tree_expand(ftree, node);
+
+    return node->left;
+}
+
+fact_tree_node_t* fact_tree_node_right(fact_tree_t* ftree, fact_tree_node_t* node)
+{
+    utils_assert(node);
+
+    if(node->lazy)
+        fact_tree_expand(ftree, node);
+
+    return node->right;
+}
+
+fact_tree_err_t fact_tree_fread(fact_tree_t* ftree, const char* filename)
+{
+    return fact_tree_fread_(ftree, filename, 0, 1);
+}
+
+fact_tree_err_t fact_tree_fread_lazy(fact_tree_t* ftree, const char* filename)
+{
+    return fact_tree_fread_(ftree, filename, 1, 1);
+}
+
+fact_tree_err_t fact_tree_fread_(fact_tree_t* ftree, const char* filename, int lazy, int journaled)
+{
+    utils_assert(ftree);
+    utils_assert(filename);
+
+    fact_tree_dtor(ftree);
+
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: %s", filename, strerror(errno));
+        return FACT_TREE_IO_ERR;
+    }
+
+    char magic[sizeof(FACT_TREE_PAGES_MAGIC) - 1] = {};
+    if(pread(fd, magic, sizeof(magic), 0) == (ssize_t) sizeof(magic) && fact_tree_pages_magic(magic)) {
+        close(fd);
+        return fact_tree_fread_pages(ftree, filename, ftree->pages_pool ? ftree->pages_pool : FACT_TREE_PAGES_POOL_DEFAULT);
+    }
+
+    struct stat fstats = {};
+    if(fstat(fd, &fstats) < 0 || fstats.st_size == 0) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: empty or unreadable file", filename);
+        close(fd);
+        return FACT_TREE_IO_ERR;
+    }
+
+    // NOTE pages are shared with the page cache and with
+    // other processes mapping the same database
+    void* map = mmap(NULL, (size_t) fstats.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(map == MAP_FAILED) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: mmap failed: %s", filename, strerror(errno));
+        return FACT_TREE_IO_ERR;
+    }
+
+    madvise(map, (size_t) fstats.st_size, MADV_SEQUENTIAL);
+
+    memstat_alloc(MEMSTAT_FILE, (size_t) fstats.st_size);
+
+    ftree->buf.ptr = (char*) map;
+    ftree->buf.len = fstats.st_size;
+    ftree->buf.pos = 0;
+
+    stopwatch_t stopwatch = {};
+    stopwatch_start(&stopwatch);
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    if(lazy) {
+        ftree->lazy.fname = strdup(filename);
+        if(!ftree->lazy.fname)
+            return FACT_TREE_ALLOC_FAIL;
+    }
+
+    if(fact_tree_buf_is_bin_(ftree))
+        err = fact_tree_fread_bin_(ftree, filename, lazy);
+    else if(lazy)
+        err = fact_tree_fread_text_lazy_(ftree, filename);
+    else
+        err = fact_tree_fread_text_(ftree, filename);
+
+    if(err != FACT_TREE_ERR_NONE) {
+        FACT_TREE_DUMP(ftree, err);
+        return err;
+    }
+
+    double elapsed_s = stopwatch_s(&stopwatch);
+
+    UTILS_LOGD(
+        LOG_CATEGORY_FTREE, 
+        "%s: loaded %zu nodes%s, %ld bytes in %.3f ms (%.1f MB/s)", 
+        filename, 
+        ftree->size, 
+        ftree->lazy.mode != FACT_TREE_LAZY_NONE ? " lazily" : "",
+        ftree->buf.len, 
+        elapsed_s * 1e3,
+        (double) ftree->buf.len / elapsed_s / 1e6
+    );
+
+    if(journaled)
+        err = fact_tree_journal_open_(ftree, filename);
+
+    // replayed inserts are placed as well
+    if(err == FACT_TREE_ERR_NONE)
+        err = fact_tree_relayout(ftree, ftree->layout);
+
+    FACT_TREE_DUMP(ftree, err);
+
+    return err;
+}
+
+static fact_tree_err_t fact_tree_journal_base_(const char* filename, journal_base_t* base)
+{
+    struct stat fstats = {};
+    if(stat(filename, &fstats) < 0) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: %s", filename, strerror(errno));
+        return FACT_TREE_IO_ERR;
+    }
+
+    base->size     = (uint64_t) fstats.st_size;
+    base->mtime_ns = fstats.st_mtim.tv_sec * 1000000000 + fstats.st_mtim.tv_nsec;
+
+    return FACT_TREE_ERR_NONE;
+}
+
+// Follows the recorded path and inserts at the leaf it ends in
+static int fact_tree_journal_apply_(void* ctx, const journal_entry_t* entry)
+{
+    fact_tree_t* ftree = (fact_tree_t*) ctx;
+    fact_tree_node_t* node = ftree->root;
+
+    for(uint32_t i = 0; node && i < entry->depth; ++i) {
+        if((entry->path[i / 8] >> (i % 8)) & 1)
+            node = fact_tree_node_right(ftree, node);
+        else
+            node = fact_tree_node_left(ftree, node);
+    }
+
+    if(!node || fact_tree_node_left(ftree, node) || fact_tree_node_right(ftree, node))
+        return -1;
+
+    fact_tree_node_t* added = NULL;
+
+    fact_tree_err_t err = fact_tree_insert_object(
+        ftree, 
+        node, 
+        entry->name, 
+        entry->name_len, 
+        entry->question, 
+        entry->question_len, 
+        &added
+    );
+
+    return err == FACT_TREE_ERR_NONE ? 0 : -1;
+}
+
+// The journal lives next to the database, inserts made since the file
+// was last written are replayed on top of it before it is attached
+fact_tree_err_t fact_tree_journal_open_(fact_tree_t* ftree, const char* filename)
+{
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+    journal_err_t journal_err = JOURNAL_ERR_NONE;
+
+    journal_base_t base = {};
+    char* journal_fname = NULL;
+
+    journal_t* log = TYPED_CALLOC(1, journal_t);
+    log verified(return FACT_TREE_ALLOC_FAIL);
+
+    log->fd = -1;
 
-#define FACT_TREE_ASSERT_OK_(fact_tree) 
+    BEGIN {
 
-#endif // _DEBUG
+        err = fact_tree_journal_base_(filename, &base);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
 
-static fact_tree_err_t fact_tree_allocate_new_node_(fact_tree_node_t** node, utils_str_t title);
+        ftree->journal.db_fname = realpath(filename, NULL);
+        journal_fname = (char*) calloc(strlen(filename) + sizeof(JOURNAL_SUFFIX_), sizeof(char));
 
-static void fact_tree_swap_nodes_(fact_tree_node_t* node_a, fact_tree_node_t* node_b);
+        if(!ftree->journal.db_fname || !journal_fname) {
+            err = FACT_TREE_ALLOC_FAIL;
+            GOTO_END;
+        }
 
-static fact_tree_err_t fact_tree_fwrite_node_(fact_tree_node_t* node, FILE* file);
+        strcpy(journal_fname, filename);
+        strcat(journal_fname, JOURNAL_SUFFIX_);
 
-static fact_tree_err_t fact_tree_fread_node_(fact_tree_t* ftree, fact_tree_node_t** node, const char* fname);
+        // the database still loads, inserts are just not persisted
+        journal_err = journal_open(log, journal_fname, &base);
+        if(journal_err == JOURNAL_IO_ERR) {
+            UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: %s, inserts are not saved", journal_fname, strerror(errno));
+            journal_err = JOURNAL_ERR_NONE;
+            journal_close(log);
+            NFREE(log);
+            GOTO_END;
+        }
+        if(journal_err != JOURNAL_ERR_NONE) GOTO_END;
 
-static fact_tree_err_t fact_tree_scan_node_name_(fact_tree_t* ftree);
+        if(log->dropped)
+            UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: journal of another snapshot, %lu bytes dropped", journal_fname, log->dropped);
 
-static int fact_tree_advance_buf_pos_(fact_tree_t* ftree);
+        journal_err = journal_replay(log, fact_tree_journal_apply_, ftree);
+        if(journal_err != JOURNAL_ERR_NONE) GOTO_END;
 
-static void fact_tree_skip_spaces_(fact_tree_t* ftree);
+        if(log->dropped)
+            UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: torn tail of %lu bytes dropped", journal_fname, log->dropped);
 
-static int fact_tree_get_height(fact_tree_t* tree);
+        UTILS_LOGD(LOG_CATEGORY_FTREE, "%s: replayed %lu inserts", journal_fname, log->records);
 
-static void fact_tree_print_node_definition_(const fact_tree_node_t* node, const char* end);
+    } END;
 
-static char* fact_tree_dump_graphviz_(fact_tree_t* fact_tree);
+    if(journal_err != JOURNAL_ERR_NONE) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: %s: %s", journal_fname, journal_strerr(journal_err), strerror(errno));
+        err = journal_err == JOURNAL_ALLOC_FAIL ? FACT_TREE_ALLOC_FAIL 
+            : journal_err == JOURNAL_APPLY_FAIL ? FACT_TREE_FORMAT_ERR 
+            : FACT_TREE_IO_ERR;
+    }
 
-static void fact_tree_dump_node_graphviz_(FILE* file, fact_tree_node_t* node, int rank);
+    NFREE(journal_fname);
 
-#ifdef _DEBUG
+    if(err != FACT_TREE_ERR_NONE || !log) {
+        if(log)
+            journal_close(log);
+        NFREE(log);
+        NFREE(ftree->journal.db_fname);
+        return err;
+    }
 
-fact_tree_err_t fact_tree_verify_(fact_tree_t* fact_tree);
+    ftree->journal.log    = log;
+    ftree->journal.db_bin = fact_tree_buf_is_bin_(ftree);
 
-void fact_tree_node_dtor_(fact_tree_t* tree, fact_tree_node_t* node);
+    // the load places the nodes afterwards
+    if(log->size > JOURNAL_COMPACT_SIZE_)
+        return fact_tree_journal_fold_(ftree);
 
-#endif // _DEBUG
+    return FACT_TREE_ERR_NONE;
+}
 
-fact_tree_err_t fact_tree_ctor(fact_tree_t* fact_tree)
+void fact_tree_journal_close_(fact_tree_t* ftree)
 {
-    utils_assert(fact_tree);
+    journal_close(ftree->journal.log);
 
-    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+    NFREE(ftree->journal.log);
+    NFREE(ftree->journal.db_fname);
+
+    ftree->journal.db_bin = 0;
+}
+
+fact_tree_err_t fact_tree_journal_append_(fact_tree_t* ftree, const fact_tree_node_t* node, const fact_tree_node_t* added)
+{
+    uint32_t depth = 0;
+    for(const fact_tree_node_t* cur = node; cur->parent; cur = cur->parent)
+        ++depth;
+
+    uint8_t* path = TYPED_CALLOC(depth / 8 + 1, uint8_t);
+    path verified(return FACT_TREE_ALLOC_FAIL);
+
+    uint32_t i = depth;
+    for(const fact_tree_node_t* cur = node; cur->parent; cur = cur->parent) {
+        --i;
+        if(cur == cur->parent->right)
+            path[i / 8] |= (uint8_t)(1u << (i % 8));
+    }
 
-    utils_str_t deflt_s = {
-        .str = strdup(DEFAULT_NODE_),
-        .len = SIZEOF(DEFAULT_NODE_) - 1
+    journal_entry_t entry = {
+        .path         = path,
+        .depth        = depth,
+        .name         = fact_tree_node_name(added),
+        .name_len     = (uint32_t) added->name_len,
+        .question     = fact_tree_node_name(node),
+        .question_len = (uint32_t) node->name_len
     };
-    
-    fact_tree_allocate_new_node_(&fact_tree->root, deflt_s);
 
-    fact_tree->size = 1;
+    journal_err_t journal_err = journal_append(ftree->journal.log, &entry);
 
-    FACT_TREE_DUMP(fact_tree, err);
+    NFREE(path);
+
+    if(journal_err != JOURNAL_ERR_NONE) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: journal: %s: %s", ftree->journal.db_fname, journal_strerr(journal_err), strerror(errno));
+        return journal_err == JOURNAL_ALLOC_FAIL ? FACT_TREE_ALLOC_FAIL : FACT_TREE_IO_ERR;
+    }
+
+    // the inserted nodes are held by the caller, so they are not relaid out
+    if(ftree->journal.log->size > JOURNAL_COMPACT_SIZE_)
+        return fact_tree_journal_fold_(ftree);
 
     return FACT_TREE_ERR_NONE;
 }
 
-void fact_tree_dtor(fact_tree_t* fact_tree)
+// Once the database file itself holds every insert the journal starts over.
+// A shared tree written anywhere may be mapped again without losing any
+fact_tree_err_t fact_tree_journal_saved_(fact_tree_t* ftree, const char* filename, int bin)
 {
-    utils_assert(fact_tree);
+    ftree->shared.unsaved = 0;
 
-    fact_tree_node_dtor_(fact_tree, fact_tree->root); 
+    if(!ftree->journal.log)
+        return FACT_TREE_ERR_NONE;
 
-    fact_tree->size = 0;
-    fact_tree->root = NULL;
+    char* fname = realpath(filename, NULL);
+    int same = fname && strcmp(fname, ftree->journal.db_fname) == 0;
+    NFREE(fname);
 
-    NFREE(fact_tree->buf.ptr);
-    fact_tree->buf.pos = 0;
-    fact_tree->buf.len = 0;
+    if(!same)
+        return FACT_TREE_ERR_NONE;
+
+    journal_base_t base = {};
+
+    fact_tree_err_t err = fact_tree_journal_base_(filename, &base);
+    err == FACT_TREE_ERR_NONE verified(return err);
+
+    journal_err_t journal_err = journal_reset(ftree->journal.log, &base);
+    if(journal_err != JOURNAL_ERR_NONE) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: journal: %s: %s", filename, journal_strerr(journal_err), strerror(errno));
+        return FACT_TREE_IO_ERR;
+    }
+
+    ftree->journal.db_bin = bin;
+
+    return FACT_TREE_ERR_NONE;
 }
 
-void fact_tree_node_dtor_(fact_tree_t* ftree, fact_tree_node_t* node)
+// Writes the tree over its database file, which empties the journal.
+// Nodes stay where they are
+fact_tree_err_t fact_tree_journal_fold_(fact_tree_t* ftree)
 {
-    if(!node) return;
+    uint64_t records = ftree->journal.log->records;
 
-    if(node->left)
-        fact_tree_node_dtor_(ftree, node->left);
-    if(node->right)
-        fact_tree_node_dtor_(ftree, node->right);
+    fact_tree_err_t err = ftree->journal.db_bin ? fact_tree_fwrite_bin(ftree, ftree->journal.db_fname) 
+                                                : fact_tree_fwrite(ftree, ftree->journal.db_fname);
+    err == FACT_TREE_ERR_NONE verified(return err);
 
-    if(ftree->buf.ptr) {
-        if(node->name.str >= ftree->buf.ptr + ftree->buf.len 
-                || node->name.str < ftree->buf.ptr)
-            NFREE(node->name.str);
-    }
-    else
-        NFREE(node->name.str);
+    UTILS_LOGD(LOG_CATEGORY_FTREE, "%s: compacted %lu journaled inserts", ftree->journal.db_fname, records);
 
-    NFREE(node);
+    return FACT_TREE_ERR_NONE;
 }
 
-fact_tree_node_t* fact_tree_guess(fact_tree_t* fact_tree)
+fact_tree_err_t fact_tree_compact(fact_tree_t* ftree)
 {
-    FACT_TREE_ASSERT_OK_(fact_tree);
-    
-    if(!fact_tree->root) {
-        UTILS_LOGE(LOG_CATEGORY_FTREE, "tree is not initialized");
-        return NULL;
+    utils_assert(ftree);
+
+    if(!ftree->journal.log) {
+        UTILS_LOGD(LOG_CATEGORY_FTREE, "no journal to compact");
+        return FACT_TREE_ERR_NONE;
     }
 
-    fact_tree_node_t* node = fact_tree->root;
+    fact_tree_err_t err = fact_tree_journal_fold_(ftree);
+    err == FACT_TREE_ERR_NONE verified(return err);
 
-    char input = CHAR_DECLINE_;
-    while(node->right != NULL) {
-        utils_colored_fprintf(stdout, ANSI_COLOR_BOLD_WHITE, "Is object ... "              );
-        utils_colored_fprintf(stdout, ANSI_COLOR_CYAN,       "%s",           node->name.str);
-        utils_colored_fprintf(stdout, ANSI_COLOR_BOLD_WHITE, "? [y/N]: "                   );
+    // objects inserted since the load sit wherever the arena had room
+    return fact_tree_relayout(ftree, ftree->layout);
+}
 
-        scanf("%c", &input);
-        clear_stdin_buffer();
+static char* fact_tree_generation_fname_(const char* filename)
+{
+    char* gen_fname = (char*) calloc(strlen(filename) + sizeof(GENERATION_SUFFIX_), sizeof(char));
+    gen_fname verified(return NULL);
 
-        if(input == CHAR_ACCEPT_)
-            node = node->right;
-        else
-            node = node->left;
-    }
-    
-    return node;
+    strcpy(gen_fname, filename);
+    strcat(gen_fname, GENERATION_SUFFIX_);
+
+    return gen_fname;
 }
 
-fact_tree_err_t fact_tree_insert(fact_tree_t* fact_tree, fact_tree_node_t* node, fact_tree_node_t** ret)
+fact_tree_err_t fact_tree_fread_shared(fact_tree_t* ftree, const char* filename)
 {
-    FACT_TREE_ASSERT_OK_(fact_tree);
-    utils_assert(ret);
-    utils_assert(node);
+    utils_assert(ftree);
+    utils_assert(filename);
 
     fact_tree_err_t err = FACT_TREE_ERR_NONE;
+    generation_err_t gen_err = GENERATION_ERR_NONE;
 
-    utils_str_t diff_s = UTILS_STR_INITLIST;
-    utils_str_t entity_s = UTILS_STR_INITLIST;
-    enum io_err_t io_err = IO_ERR_NONE;
+    char* gen_fname = fact_tree_generation_fname_(filename);
+    generation_t* gen = TYPED_CALLOC(1, generation_t);
 
-    utils_colored_fprintf(stdout, ANSI_COLOR_BOLD_WHITE, "Enter object's name: "); 
-    io_err = input_string_until_correct(&entity_s.str, &entity_s.len);
-    io_err == IO_ERR_NONE verified(return FACT_TREE_IO_ERR);
+    uint64_t seen = 0;
 
-    utils_colored_fprintf(stdout, ANSI_COLOR_BOLD_WHITE, "Enter the difference between "                );
-    utils_colored_fprintf(stdout, ANSI_COLOR_MAGENTA,    "%s",                           entity_s.str   );
-    utils_colored_fprintf(stdout, ANSI_COLOR_BOLD_WHITE, " and "                                        );
-    utils_colored_fprintf(stdout, ANSI_COLOR_MAGENTA,    "%s",                           node->name.str);
-    utils_colored_fprintf(stdout, ANSI_COLOR_BOLD_WHITE, ": "                                           );
+    // the file is mapped into a tree of its own, which replaces
+    // this one only once it is known to be a shared database
+    fact_tree_t fresh = FACT_TREE_INIT_LIST
 
-    io_err = input_string_until_correct(&diff_s.str, &diff_s.len);
-    io_err == IO_ERR_NONE verified(return FACT_TREE_IO_ERR);
+    fresh.layout     = ftree->layout;
+    fresh.pages_pool = ftree->pages_pool;
+    def_cache_set_budget(&fresh.defs, ftree->defs.budget);
 
-    fact_tree_node_t *node_entity_old = NULL, *node_entity_new = NULL;
+    BEGIN {
+        if(!gen_fname || !gen) {
+            err = FACT_TREE_ALLOC_FAIL;
+            GOTO_END;
+        }
 
-    err = fact_tree_allocate_new_node_(&node_entity_old, diff_s);
-    err == FACT_TREE_ERR_NONE verified(return FACT_TREE_ALLOC_FAIL);
+        gen_err = generation_open(gen, gen_fname);
+        if(gen_err != GENERATION_ERR_NONE) {
+            UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: %s: %s", gen_fname, generation_strerr(gen_err), strerror(errno));
+            NFREE(gen);
+            err = FACT_TREE_IO_ERR;
+            GOTO_END;
+        }
 
-    fact_tree_swap_nodes_(node_entity_old, node);
+        // read before the file is mapped: a version published in
+        // between is then seen as newer and picked up on refresh
+        seen = generation_get(gen);
 
-    err = fact_tree_allocate_new_node_(&node_entity_new, entity_s);
-    err == FACT_TREE_ERR_NONE verified(return FACT_TREE_ALLOC_FAIL);
+        err = fact_tree_fread_(&fresh, filename, 1, 0);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
 
-    node->left = node_entity_old;
-    node->right = node_entity_new;
-    
-    node_entity_new->parent = node;
-    node_entity_old->parent = node;
+        if(fresh.lazy.mode != FACT_TREE_LAZY_BIN) {
+            UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: only binary databases can be shared", filename);
+            err = FACT_TREE_FORMAT_ERR;
+            GOTO_END;
+        }
 
-    ++fact_tree->size;
+        fresh.shared.gen  = gen;
+        fresh.shared.seen = seen;
 
-    *ret = node_entity_new;
+        gen = NULL;
 
-    return FACT_TREE_ERR_NONE;
-}
+        fact_tree_dtor(ftree);
 
-const fact_tree_node_t* fact_tree_find_object(const fact_tree_node_t* node, const char* name)
-{
-    const fact_tree_node_t *cur = NULL, *ret = NULL;
+        *ftree = fresh;
+        fresh  = {};
 
-    if(node->left && (ret = fact_tree_find_object(node->left, name)))
-        cur = ret;
-    
-    if(node->right && (ret = fact_tree_find_object(node->right, name)))
-        cur = ret;
+        UTILS_LOGD(LOG_CATEGORY_FTREE, "%s: mapped shared, generation %lu", filename, seen);
+
+    } END;
 
-    if(!node->left && !node->right) {
-        if(strncmp(node->name.str, name, node->name.len) == 0)
-            cur = node;
+    if(gen) {
+        generation_close(gen);
+        NFREE(gen);
     }
-    
-    return cur;
+
+    fact_tree_dtor(&fresh);
+
+    NFREE(gen_fname);
+
+    return err;
 }
 
-fact_tree_err_t fact_tree_get_object_path(fact_tree_t* ftree, const fact_tree_node_t* node, stk_t* stk)
+fact_tree_err_t fact_tree_publish(fact_tree_t* ftree, const char* filename)
 {
-    utils_assert(node);
-    utils_assert(stk);
+    utils_assert(ftree);
+    utils_assert(filename);
 
-    stack_ctor(stk, (size_t) fact_tree_get_height(ftree));
+    // the file is renamed into place, processes
+    // still mapping the old one keep reading it
+    fact_tree_err_t err = fact_tree_fwrite_bin(ftree, filename);
+    err == FACT_TREE_ERR_NONE verified(return err);
 
-    while(node) {
-        stack_push(stk, node);
-        node = node->parent;
+    char* gen_fname = fact_tree_generation_fname_(filename);
+    gen_fname verified(return FACT_TREE_ALLOC_FAIL);
+
+    generation_t gen = {};
+    uint64_t value = 0;
+
+    generation_err_t gen_err = generation_open(&gen, gen_fname);
+
+    if(gen_err == GENERATION_ERR_NONE) {
+        gen_err = generation_bump(&gen, &value);
+        generation_close(&gen);
     }
 
-    return FACT_TREE_ERR_NONE;
-}
+    if(gen_err != GENERATION_ERR_NONE) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: %s: %s", gen_fname, generation_strerr(gen_err), strerror(errno));
+        err = FACT_TREE_IO_ERR;
+    }
+    else {
+        UTILS_LOGD(LOG_CATEGORY_FTREE, "%s: published generation %lu", filename, value);
+    }
 
-void fact_tree_print_node_definition_(const fact_tree_node_t* node, const char* end)
-{
-    utils_assert(node);
-    utils_assert(node->parent);
-    utils_assert(end);
+    NFREE(gen_fname);
 
-    if(node == node->parent->left)
-        printf_and_say(" not %s%s", node->parent->name.str, end);
-    else if(node == node->parent->right)
-        printf_and_say(" %s%s", node->parent->name.str, end);
+    return err;
 }
 
-fact_tree_err_t fact_tree_print_definition(fact_tree_t* ftree, const fact_tree_node_t* node)
+fact_tree_err_t fact_tree_refresh(fact_tree_t* ftree)
 {
-    FACT_TREE_ASSERT_OK_(ftree);
-    utils_assert(node);
+    utils_assert(ftree);
 
-    fact_tree_err_t tree_err = FACT_TREE_ERR_NONE;
-    
-    STACK_MAKE(stk);
+    if(!ftree->shared.gen || generation_get(ftree->shared.gen) == ftree->shared.seen)
+        return FACT_TREE_ERR_NONE;
 
-    tree_err = fact_tree_get_object_path(ftree, node, &stk);
-    tree_err == FACT_TREE_ERR_NONE verified(return tree_err);
+    // objects learned since the load would go with the old mapping
+    if(ftree->shared.unsaved)
+        return FACT_TREE_UNSAVED_ERR;
 
-    printf_and_say("%s", node->name.str);
+    uint64_t seen = ftree->shared.seen;
 
-    const fact_tree_node_t *cur = NULL;
-    stack_pop(&stk, &cur);
+    // the name goes away with the old mapping
+    char* filename = strdup(ftree->lazy.fname);
+    filename verified(return FACT_TREE_ALLOC_FAIL);
 
-    while(stk.size) {
-        stack_pop(&stk, &cur);
-        fact_tree_print_node_definition_(cur, stk.size ? "," : "");
-    }
-    
-    putc('\n', stdout);
+    fact_tree_err_t err = fact_tree_fread_shared(ftree, filename);
+
+    if(err == FACT_TREE_ERR_NONE)
+        UTILS_LOGD(LOG_CATEGORY_FTREE, "%s: generation %lu replaced %lu", filename, ftree->shared.seen, seen);
 
-    return tree_err;
+    NFREE(filename);
+
+    return err;
 }
 
-fact_tree_err_t fact_tree_print_difference(fact_tree_t* ftree, const fact_tree_node_t* node_a, const fact_tree_node_t* node_b)
+// Allocates size zeroed bytes and builds one of the structures derived
+// from the tree in them. what names it in the log, build gives the count
+// of what counted says
+static void* fact_tree_lazy_build_(
+    fact_tree_t* ftree, 
+    size_t size, 
+    fact_tree_lazy_build_fn_t build, 
+    const char* what, 
+    const char* counted)
 {
-    FACT_TREE_ASSERT_OK_(ftree);
-    utils_assert(node_a);
-    utils_assert(node_b);
+    void* built = calloc(1, size);
+    built verified(return NULL);
 
-    fact_tree_err_t tree_err = FACT_TREE_ERR_NONE;
-    
-    STACK_MAKE(stk_a); STACK_MAKE(stk_b);
+    stopwatch_t stopwatch = {};
+    stopwatch_start(&stopwatch);
 
-    tree_err = fact_tree_get_object_path(ftree, node_a, &stk_a);
-    tree_err == FACT_TREE_ERR_NONE verified(return tree_err);
+    size_t count = 0;
 
-    tree_err = fact_tree_get_object_path(ftree, node_b, &stk_b);
-    tree_err == FACT_TREE_ERR_NONE verified(return tree_err);
+    fact_tree_err_t err = build(ftree, built, &count);
+    if(err != FACT_TREE_ERR_NONE) {
+        UTILS_LOGE(LOG_CATEGORY_FTREE, "%s: %s", what, fact_tree_strerr(err));
+        NFREE(built);
+        return NULL;
+    }
 
-    const fact_tree_node_t *cur_a = NULL, *cur_b = NULL;
+    UTILS_LOGD(LOG_CATEGORY_FTREE, "%s of %zu %s built in %.3f ms", what, count, counted, stopwatch_s(&stopwatch) * 1e3);
 
-    stack_pop(&stk_a, &cur_a); stack_pop(&stk_a, &cur_a);
-    stack_pop(&stk_b, &cur_b); stack_pop(&stk_b, &cur_b);
+    return built;
+}
 
-    printf_and_say("%s and %s both:", node_a->name.str, node_b->name.str);
+static fact_tree_err_t fact_tree_soa_build_(fact_tree_t* ftree, void* built, size_t* count)
+{
+    fact_tree_soa_t* soa = (fact_tree_soa_t*) built;
 
-    while(cur_a == cur_b) {
-        fact_tree_print_node_definition_(cur_a, "");
-        stack_pop(&stk_a, &cur_a);
-        stack_pop(&stk_b, &cur_b);
-        if(cur_a == cur_b) printf(",");
-    }
+    fact_tree_err_t err = fact_tree_soa_build(ftree, soa);
+    *count = soa->size;
 
-    printf_and_say(", but %s", node_a->name.str);
+    return err;
+}
 
-    for( ;; ) {
-        fact_tree_print_node_definition_(cur_a, stk_a.size ? "," : "");
-        if(stk_a.size) stack_pop(&stk_a, &cur_a);
-        else break;
-    }
+// Lazily loaded trees are never copied, it would build them whole
+fact_tree_soa_t* fact_tree_soa_(fact_tree_t* ftree)
+{
+    if(ftree->soa || ftree->lazy.mode != FACT_TREE_LAZY_NONE)
+        return ftree->soa;
 
-    printf_and_say(", and %s", node_b->name.str);
+    ftree->soa = (fact_tree_soa_t*) fact_tree_lazy_build_(
+        ftree, sizeof(fact_tree_soa_t), fact_tree_soa_build_, "index-based copy", "nodes");
 
-    for( ;; ) {
-        fact_tree_print_node_definition_(cur_b, stk_b.size ? "," : "");
-        if(stk_b.size) stack_pop(&stk_b, &cur_b);
-        else break;
-    }
-    
-    puts(".\n");
+    if(ftree->soa)
+        memstat_alloc(MEMSTAT_INDEX, ftree->soa->size * FACT_TREE_SOA_NODE_BYTES_);
 
-    return tree_err;
+    return ftree->soa;
 }
 
-#undef BUF_INITIAL_SIZE_
-
-fact_tree_err_t fact_tree_fwrite(fact_tree_t* fact_tree, const char* filename)
+void fact_tree_soa_drop_(fact_tree_t* ftree)
 {
-    utils_assert(filename);
+    if(!ftree->soa)
+        return;
 
-    FILE* file = open_file(filename, "w");
-    file verified(return FACT_TREE_IO_ERR);
+    memstat_free(MEMSTAT_INDEX, ftree->soa->size * FACT_TREE_SOA_NODE_BYTES_);
 
-    fact_tree_err_t err = fact_tree_fwrite_node_(fact_tree->root, file);
+    fact_tree_soa_dtor(ftree->soa);
+    NFREE(ftree->soa);
+}
 
-    UTILS_LOGD(LOG_CATEGORY_FTREE, "Writing done");
+static fact_tree_err_t fact_tree_index_build_(fact_tree_t* ftree, void* built, size_t* count)
+{
+    fact_tree_index_t* index = (fact_tree_index_t*) built;
 
-    fclose(file);
+    fact_tree_err_t err = fact_tree_index_build(index, ftree->soa, ftree->names.size);
+    *count = index->size;
 
     return err;
 }
 
-fact_tree_err_t fact_tree_fwrite_node_(fact_tree_node_t* node, FILE* file)
+// Built from the index-based copy, which interns every name on the way.
+// Loads leave names out of the pool, so a tree that is never looked up
+// by name does not pay for it
+fact_tree_index_t* fact_tree_index_(fact_tree_t* ftree)
 {
-    utils_assert(node);
-    utils_assert(file);
+    if(ftree->index)
+        return ftree->index;
 
-    fact_tree_err_t err = FACT_TREE_ERR_NONE;
-    int io_err = 0;
+    fact_tree_soa_(ftree) verified(return NULL);
 
-    io_err = fprintf(file, "(");
-    io_err >= 0 verified(return FACT_TREE_IO_ERR);
+    ftree->index = (fact_tree_index_t*) fact_tree_lazy_build_(
+        ftree, sizeof(fact_tree_index_t), fact_tree_index_build_, "name index", "leaves");
 
-    io_err = fprintf(file, " \"%s\" ", node->name.str);
-    io_err >= 0 verified(return FACT_TREE_IO_ERR);
+    return ftree->index;
+}
 
-    if(node->left)
-        err = fact_tree_fwrite_node_(node->left, file);
-    else
-        fprintf(file, NIL_STR);
+void fact_tree_index_drop_(fact_tree_t* ftree)
+{
+    if(!ftree->index)
+        return;
 
-    if(node->right)
-        err = fact_tree_fwrite_node_(node->right, file);
-    else
-        fprintf(file, " " NIL_STR " ");
+    fact_tree_index_dtor(ftree->index);
+    NFREE(ftree->index);
+}
+
+static fact_tree_err_t fact_tree_attrs_build_(fact_tree_t* ftree, void* built, size_t* count)
+{
+    fact_tree_attrs_t* attrs = (fact_tree_attrs_t*) built;
 
-    io_err = fprintf(file, ")");
-    io_err >= 0 verified(return FACT_TREE_IO_ERR);
+    fact_tree_err_t err = fact_tree_attrs_build(attrs, ftree->soa, ftree->names.size);
+    *count = attrs->questions_size;
 
     return err;
 }
 
-int fact_tree_advance_buf_pos_(fact_tree_t* ftree)
+// Leaves are numbered in the order of the copy, which is preorder
+fact_tree_attrs_t* fact_tree_attrs_(fact_tree_t* ftree)
 {
-    FACT_TREE_ASSERT_OK_(ftree);
+    if(ftree->attrs)
+        return ftree->attrs;
 
-    if(ftree->buf.pos < ftree->buf.len - 1) {
-        ftree->buf.pos++;
-        return 0;
-    }
-    else
-        return 1;
-}
+    fact_tree_soa_(ftree) verified(return NULL);
 
-void fact_tree_skip_spaces_(fact_tree_t* ftree)
-{
-    FACT_TREE_ASSERT_OK_(ftree);
+    ftree->attrs = (fact_tree_attrs_t*) fact_tree_lazy_build_(
+        ftree, sizeof(fact_tree_attrs_t), fact_tree_attrs_build_, "attribute index", "questions");
 
-    while(isspace(ftree->buf.ptr[ftree->buf.pos])) {
-        if(fact_tree_advance_buf_pos_(ftree))
-            break;
-    }
+    return ftree->attrs;
 }
 
-static int fact_tree_get_height(fact_tree_t* ftree)
+void fact_tree_attrs_drop_(fact_tree_t* ftree)
 {
-    FACT_TREE_ASSERT_OK_(ftree);
+    if(!ftree->attrs)
+        return;
 
-    return (int)ceil(log2(ftree->size));
+    fact_tree_attrs_dtor(ftree->attrs);
+    NFREE(ftree->attrs);
 }
 
-fact_tree_err_t fact_tree_scan_node_name_(fact_tree_t* ftree)
+// The leaf that became a question is replaced by its moved copy in
+// the same place. The new leaf comes last unless its name is taken:
+// where it goes among equal leaves is unknown then, so the index is
+// dropped and built anew by the next lookup
+void fact_tree_index_insert_(fact_tree_t* ftree, const fact_tree_node_t* node, fact_tree_node_t* old, fact_tree_node_t* added)
 {
-    FACT_TREE_ASSERT_OK_(ftree);
+    fact_tree_index_t* index = ftree->index;
 
-    int name_len = 0;
-    sscanf(ftree->buf.ptr + ftree->buf.pos, " \"%*[^\"]\"%n", &name_len);
+    if(!index)
+        return;
 
-    ftree->buf.pos += (size_t) name_len;
+    if(!fact_tree_index_replace(index, node, old)
+       || fact_tree_index_last(index, added->name_id) != FACT_TREE_INDEX_NIL
+       || fact_tree_index_add(index, added) != FACT_TREE_ERR_NONE)
+        fact_tree_index_drop_(ftree);
+}
 
-    ftree->buf.ptr[ftree->buf.pos - 1] = '\0';
+static int fact_tree_node_addr_cmp_(const void* a, const void* b)
+{
+    const fact_tree_node_t* node_a = *(fact_tree_node_t* const*) a;
+    const fact_tree_node_t* node_b = *(fact_tree_node_t* const*) b;
 
-    return FACT_TREE_ERR_NONE;
+    return (node_a > node_b) - (node_a < node_b);
 }
 
-#define FTREE_LOG_SYNTAX_ERR(fname, ftree, expc) \
-    UTILS_LOGE( \
-        LOG_CATEGORY_FTREE, \
-        "%s:1:%ld: syntax error: unexpected symbol <%c>, expected <" expc ">", \
-        fname, \
-        ftree->buf.pos, \
-        ftree->buf.ptr[ftree->buf.pos] \
-    );
-
-fact_tree_err_t fact_tree_fread_node_(fact_tree_t* ftree, fact_tree_node_t** node, const char* fname)
+// Nodes are not allocated anew: the places they occupy in the arena are
+// sorted by address and handed out in layout order, so neither the arena
+// nor the names the nodes hold are touched
+fact_tree_err_t fact_tree_relayout(fact_tree_t* ftree, fact_tree_layout_t layout)
 {
     FACT_TREE_ASSERT_OK_(ftree);
 
-    fact_tree_err_t err = FACT_TREE_ERR_NONE;
-
-    FACT_TREE_DUMP(ftree, err);
-
-    if(ftree->buf.ptr[ftree->buf.pos] == '(') {
-        utils_str_t name = { .str = NULL, .len = 0 };
-        err = fact_tree_allocate_new_node_(node, name);
-        err == FACT_TREE_ERR_NONE verified(return err);
-
-        fact_tree_advance_buf_pos_(ftree);
-        fact_tree_skip_spaces_(ftree);
+    if(layout == FACT_TREE_LAYOUT_NONE || ftree->lazy.mode != FACT_TREE_LAZY_NONE || !ftree->root)
+        return FACT_TREE_ERR_NONE;
 
-        if(ftree->buf.ptr[ftree->buf.pos] != '"') {
-            FTREE_LOG_SYNTAX_ERR(fname, ftree, "\"");
-            return FACT_TREE_SYNTAX_ERR;
-        }
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
 
-        ssize_t buf_pos_prev = ftree->buf.pos;
-        err = fact_tree_scan_node_name_(ftree);
-        err == FACT_TREE_ERR_NONE verified(return err);
+    stopwatch_t stopwatch = {};
+    stopwatch_start(&stopwatch);
 
-        (*node)->name.str = ftree->buf.ptr + buf_pos_prev + 1;
-        (*node)->name.len = (size_t)(ftree->buf.pos - buf_pos_prev);
+    fact_tree_node_t** order = NULL;
+    fact_tree_soa_link_t* links = NULL;
+    fact_tree_node_t** slots = NULL;
+    fact_tree_node_t* nodes = NULL;
+    size_t size = 0;
 
-        fact_tree_skip_spaces_(ftree);
+    BEGIN {
+        err = fact_tree_layout_order(ftree, layout, &order, &links, &size);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
 
-        err = fact_tree_fread_node_(ftree, &(*node)->left, fname);
-        err == FACT_TREE_ERR_NONE verified(return err);
+        slots = TYPED_CALLOC(size, fact_tree_node_t*);
+        nodes = TYPED_CALLOC(size, fact_tree_node_t);
 
-        if((*node)->left) {
-            UTILS_LOGD(LOG_CATEGORY_FTREE, "%s -> %s", (*node)->left->name.str, (*node)->name.str);
-            (*node)->left->parent = (*node);
+        if(!slots || !nodes) {
+            err = FACT_TREE_ALLOC_FAIL;
+            GOTO_END;
         }
 
-        fact_tree_skip_spaces_(ftree);
-
-        err = fact_tree_fread_node_(ftree, &(*node)->right, fname);
-        err == FACT_TREE_ERR_NONE verified(return err);
-
-        if((*node)->right) {
-            UTILS_LOGD(LOG_CATEGORY_FTREE, "%s -> %s", (*node)->right->name.str, (*node)->name.str);
-            (*node)->right->parent = (*node);
-        }
+        memcpy(slots, order, size * sizeof(slots[0]));
+        qsort(slots, size, sizeof(slots[0]), fact_tree_node_addr_cmp_);
 
-        ftree->size++;
+        for(size_t i = 0; i < size; ++i)
+            nodes[i] = *order[i];
 
-        if(ftree->buf.ptr[ftree->buf.pos] != ')') {
-            FTREE_LOG_SYNTAX_ERR(fname, ftree, ")");
-            return FACT_TREE_SYNTAX_ERR;
-        }
+        for(size_t i = 0; i < size; ++i) {
+            fact_tree_node_t* node = slots[i];
 
-        fact_tree_advance_buf_pos_(ftree);
-        fact_tree_skip_spaces_(ftree);
-    }
-    else if(strncmp(ftree->buf.ptr + ftree->buf.pos, NIL_STR, SIZEOF(NIL_STR) - 1) == 0) {
+            *node = nodes[i];
 
-        if(ftree->buf.ptr[ftree->buf.pos] != 'n') {
-            FTREE_LOG_SYNTAX_ERR(fname, ftree, "n");
-            return FACT_TREE_SYNTAX_ERR;
+            node->left   = links[i].left   != FACT_TREE_SOA_NIL ? slots[links[i].left]   : NULL;
+            node->right  = links[i].right  != FACT_TREE_SOA_NIL ? slots[links[i].right]  : NULL;
+            node->parent = links[i].parent != FACT_TREE_SOA_NIL ? slots[links[i].parent] : NULL;
         }
 
-        ftree->buf.pos += SIZEOF(NIL_STR) - 1;
-        fact_tree_skip_spaces_(ftree);
-        *node = NULL;
-    }
-    else {
-        FTREE_LOG_SYNTAX_ERR(fname, ftree, "(");
-        return FACT_TREE_SYNTAX_ERR;
-    }
-
-    return FACT_TREE_ERR_NONE;
-}
-
-#undef FTREE_LOG_SYNTAX_ERR
+        ftree->root = slots[0];
 
-fact_tree_err_t fact_tree_fread(fact_tree_t* ftree, const char* filename)
-{
-    utils_assert(ftree);
-    utils_assert(filename);
+        // jumps still point at the old places
+        fact_tree_link_(ftree->root);
 
-    fact_tree_dtor(ftree);
+        // the copy, the index and the cache point at nodes by their old places
+        fact_tree_soa_drop_(ftree);
+        fact_tree_index_drop_(ftree);
+        fact_tree_attrs_drop_(ftree);
+        def_cache_clear(&ftree->defs);
 
-    FILE* file = open_file(filename, "r");
-    file verified(return FACT_TREE_IO_ERR);
-    
-    size_t fsize = get_file_size(file);
+    } END;
 
-    ftree->buf.ptr = TYPED_CALLOC(fsize, char);
-    ftree->buf.ptr verified(return FACT_TREE_ALLOC_FAIL);
+    NFREE(order);
+    NFREE(links);
+    NFREE(slots);
+    NFREE(nodes);
 
-    size_t bytes_transferred = fread(ftree->buf.ptr, sizeof(ftree->buf.ptr[0]), fsize, file);
-    fclose(file);
-    // TODO check for errors
-    ftree->buf.len = (unsigned) bytes_transferred;
-    
-    fact_tree_err_t err = fact_tree_fread_node_(ftree, &ftree->root, filename);
+    err == FACT_TREE_ERR_NONE verified(return err);
 
-    if(err != FACT_TREE_ERR_NONE) {
-        FACT_TREE_DUMP(ftree, err);
-        return err;
-    }
+    double elapsed_s = stopwatch_s(&stopwatch);
 
-    FACT_TREE_DUMP(ftree, err);
+    UTILS_LOGD(
+        LOG_CATEGORY_FTREE, 
+        "relaid out %zu nodes in %s order in %.3f ms", 
+        size, 
+        layout == FACT_TREE_LAYOUT_VEB ? "van Emde Boas" : "BFS", 
+        elapsed_s * 1e3
+    );
 
     return FACT_TREE_ERR_NONE;
 }
@@ -551,30 +2701,76 @@ const char* fact_tree_strerr(fact_tree_err_t err)
             return "io error";
         case FACT_TREE_SYNTAX_ERR:
             return "syntax error";
+        case FACT_TREE_FORMAT_ERR:
+            return "invalid binary, paged or journal file";
+        case FACT_TREE_EMBED_ERR:
+            return "no embedded database or it is taken already";
+        case FACT_TREE_LAZY_ERR:
+            return "not supported by lazily loaded databases";
+        case FACT_TREE_UNSAVED_ERR:
+            return "unsaved inserts, the newer database is not loaded";
         default:
             return "unknown";
     }
 }
 
-fact_tree_err_t fact_tree_allocate_new_node_(fact_tree_node_t** node, utils_str_t name)
+fact_tree_err_t fact_tree_allocate_new_node_(arena_t* arena, fact_tree_node_t** node, utils_str_t name)
 {
+    utils_assert(arena);
     utils_assert(node);
 
-    fact_tree_node_t* node_tmp = (fact_tree_node_t*)calloc(1, sizeof(node_tmp[0]));
+    fact_tree_node_t* node_tmp = (fact_tree_node_t*) arena_alloc(arena, sizeof(node_tmp[0]));
     
     node_tmp verified(return FACT_TREE_ALLOC_FAIL);
 
-    node_tmp->name = name;
+    fact_tree_set_name_(node_tmp, name.str, name.len);
 
     *node = node_tmp;
 
     return FACT_TREE_ERR_NONE;
 }
 
+// Short names are copied into the node, longer ones stay where str points
+void fact_tree_set_name_(fact_tree_node_t* node, char* str, size_t len)
+{
+    if(len > FACT_TREE_NAME_INLINE)
+        node->name.str = str;
+    else if(len)
+        memcpy(node->name.buf, str, len);
+
+    node->name_len = len;
+}
+
+uint32_t fact_tree_node_name_id(fact_tree_t* ftree, fact_tree_node_t* node)
+{
+    utils_assert(ftree);
+    utils_assert(node);
+
+    // nodes move when they are relaid out,
+    // so an inline name is never lent to the pool
+    if(node->name_id == STR_POOL_NONE)
+        node->name_id = node->name_len > FACT_TREE_NAME_INLINE 
+                      ? str_pool_intern(&ftree->names, node->name.str, node->name_len)
+                      : str_pool_intern_copy(&ftree->names, node->name.buf, node->name_len, &ftree->arena);
+
+    return node->name_id;
+}
+
 void fact_tree_swap_nodes_(fact_tree_node_t* node_a, fact_tree_node_t* node_b)
 {
     // FIXME fix swap
     utils_swap(&node_a->name, &node_b->name, sizeof(node_a->name));
+    utils_swap(&node_a->name_len, &node_b->name_len, sizeof(node_a->name_len));
+    utils_swap(&node_a->name_id, &node_b->name_id, sizeof(node_a->name_id));
+}
+
+// Says text of any length, printf_and_say cuts it at its buffer
+void fact_tree_say_(const char* text)
+{
+    fputs(text, stdout);
+    fflush(stdout);
+
+    festival_say_text(text);
 }
 
 void printf_and_say(const char* fmt, ...)
@@ -650,6 +2846,11 @@ void fact_tree_dump(fact_tree_t* fact_tree, fact_tree_err_t err, const char* msg
         utils_log_fprintf("buf.len = %ld\n", fact_tree->buf.len); 
         utils_log_fprintf("buf.ptr[%p] = ", fact_tree->buf.ptr); 
 
+        if(fact_tree_buf_is_bin_(fact_tree)) {
+            utils_log_fprintf("(binary database)\n");
+            GOTO_END;
+        }
+
         if(err == FACT_TREE_INVALID_BUFPOS) {
             for(ssize_t i = 0; i < fact_tree->buf.len; ++i) {
                 utils_log_fprintf("%c", fact_tree->buf.ptr[i]);
@@ -712,7 +2913,14 @@ char* fact_tree_dump_graphviz_(fact_tree_t* fact_tree)
     //     "];\n"
     // );
 
-    fact_tree_dump_node_graphviz_(file, fact_tree->root, 1);
+    // children go first, the same as the dot files written before
+    fact_tree_walk_t walk;
+    fact_tree_walk_begin(&walk, fact_tree, fact_tree->root, FACT_TREE_WALK_POST | FACT_TREE_WALK_BUILT);
+
+    while(fact_tree_walk_next(&walk))
+        fact_tree_dump_node_graphviz_(file, walk.node, (int) walk.depth + 1);
+
+    fact_tree_walk_end(&walk);
 
     fprintf(file, "};");
 
@@ -742,17 +2950,12 @@ void fact_tree_dump_node_graphviz_(FILE* file, fact_tree_node_t* node, int rank)
 
     if(!node) return;
 
-    if(node->left)
-        fact_tree_dump_node_graphviz_(file, node->left, rank + 1); 
-    if(node->right) 
-        fact_tree_dump_node_graphviz_(file, node->right, rank + 1);
-
     if(!node->left && !node->right)
         fprintf(
             file, 
             "node_%p["
             "shape=record,"
-            "label=\" { parent: %p | addr: %p | name: \' %s \' | { L: %p | R: %p } } \","
+            "label=\" { parent: %p | addr: %p | name: \' %.*s \' | { L: %p | R: %p } } \","
             "style=\"filled\","
             "color=" CLR_GREEN_BOLD_ ","
             "fillcolor=" CLR_GREEN_LIGHT_ ","
@@ -761,7 +2964,8 @@ void fact_tree_dump_node_graphviz_(FILE* file, fact_tree_node_t* node, int rank)
             node,
             node->parent,
             node,
-            node->name.str,
+            (int) node->name_len,
+            fact_tree_node_name(node),
             node->left,
             node->right,
             rank
@@ -780,7 +2984,7 @@ void fact_tree_dump_node_graphviz_(FILE* file, fact_tree_node_t* node, int rank)
                 "<td colspan=\"2\">addr: %p</td>"
               "</tr>"
               "<tr>"
-                "<td colspan=\"2\">name: %s</td>"
+                "<td colspan=\"2\">name: %.*s</td>"
               "</tr>"
               "<tr>"
                 "<td bgcolor=" CLR_RED_LIGHT_ ">L: %p</td>"
@@ -792,7 +2996,8 @@ void fact_tree_dump_node_graphviz_(FILE* file, fact_tree_node_t* node, int rank)
             node,
             node->parent,
             node,
-            node->name.str,
+            (int) node->name_len,
+            fact_tree_node_name(node),
             node->left,
             node->right,
             rank
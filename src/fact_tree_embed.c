@@ -0,0 +1,268 @@
+#include "fact_tree_embed.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+
+#include "logutils.h"
+#include "memutils.h"
+#include "assertutils.h"
+#include "utils.h"
+#include "wbuf.h"
+#include "stopwatch.h"
+#include "fact_tree_layout.h"
+
+#define LOG_CATEGORY_EMBED "EMBED"
+#define LINE_MAX_LEN_ 256
+
+// nodes are static and shared by the whole process
+static int fact_tree_embedded_taken_ = 0;
+
+fact_tree_err_t fact_tree_fread_embedded(fact_tree_t* ftree)
+{
+    utils_assert(ftree);
+
+    if(!fact_tree_has_embedded() || fact_tree_embedded_taken_) {
+        UTILS_LOGE(LOG_CATEGORY_EMBED, "%s", fact_tree_strerr(FACT_TREE_EMBED_ERR));
+        return FACT_TREE_EMBED_ERR;
+    }
+
+    stopwatch_t stopwatch = {};
+    stopwatch_start(&stopwatch);
+
+    fact_tree_dtor(ftree);
+
+    ftree->root = fact_tree_embedded.size ? &fact_tree_embedded.nodes[0] : NULL;
+    ftree->size = fact_tree_embedded.size;
+
+    fact_tree_embedded_taken_ = 1;
+
+    double elapsed_s = stopwatch_s(&stopwatch);
+
+    UTILS_LOGD(
+        LOG_CATEGORY_EMBED,
+        "%s: %zu embedded nodes in %.3f ms",
+        fact_tree_embedded.source,
+        fact_tree_embedded.size,
+        elapsed_s * 1e3
+    );
+
+    return fact_tree_relayout(ftree, ftree->layout);
+}
+
+static void fact_tree_cpp_printf_(wbuf_t* wbuf, const char* fmt, ...)
+    __attribute__ ((format (printf, 2, 3)));
+
+void fact_tree_cpp_printf_(wbuf_t* wbuf, const char* fmt, ...)
+{
+    char line[LINE_MAX_LEN_] = {};
+
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    utils_assert(len >= 0 && (size_t) len < sizeof(line));
+
+    wbuf_put(wbuf, line, (size_t) len);
+}
+
+// Octal escapes are always three digits long, so a digit
+// following one is never taken as a part of it
+static void fact_tree_cpp_put_char_(wbuf_t* wbuf, char chr)
+{
+    unsigned char byte = (unsigned char) chr;
+
+    if(byte >= ' ' && byte <= '~' && byte != '"' && byte != '\\' && byte != '\'') {
+        wbuf_put(wbuf, &chr, 1);
+        return;
+    }
+
+    fact_tree_cpp_printf_(wbuf, "\\%03o", byte);
+}
+
+static void fact_tree_cpp_put_string_(wbuf_t* wbuf, const char* str, size_t len)
+{
+    WBUF_PUT_LITERAL(wbuf, "\"");
+
+    for(size_t i = 0; i < len; ++i)
+        fact_tree_cpp_put_char_(wbuf, str[i]);
+
+    WBUF_PUT_LITERAL(wbuf, "\"");
+}
+
+// A string literal needs room for the terminating null,
+// names filling the whole buffer are spelled out char by char
+static void fact_tree_cpp_put_inline_(wbuf_t* wbuf, const char* str, size_t len)
+{
+    if(len < FACT_TREE_NAME_INLINE) {
+        fact_tree_cpp_put_string_(wbuf, str, len);
+        return;
+    }
+
+    WBUF_PUT_LITERAL(wbuf, "{ ");
+
+    for(size_t i = 0; i < len; ++i) {
+        WBUF_PUT_LITERAL(wbuf, "'");
+        fact_tree_cpp_put_char_(wbuf, str[i]);
+        WBUF_PUT_LITERAL(wbuf, "'");
+
+        if(i + 1 < len)
+            WBUF_PUT_LITERAL(wbuf, ", ");
+    }
+
+    WBUF_PUT_LITERAL(wbuf, " }");
+}
+
+static void fact_tree_cpp_put_link_(wbuf_t* wbuf, const char* field, uint32_t id)
+{
+    if(id == FACT_TREE_SOA_NIL)
+        fact_tree_cpp_printf_(wbuf, ", .%s = NULL", field);
+    else
+        fact_tree_cpp_printf_(wbuf, ", .%s = &nodes_[%u]", field, id);
+}
+
+// Depths and skew-binary jumps by number, the way the tree links them
+// in memory, so embedded nodes need no linking at startup. Parents
+// go before their children in the order
+static void fact_tree_cpp_link_(const fact_tree_soa_link_t* links, size_t size, uint32_t* depth, uint32_t* jump)
+{
+    for(size_t i = 0; i < size; ++i) {
+        uint32_t parent = links[i].parent;
+
+        depth[i] = 0;
+        jump[i]  = FACT_TREE_SOA_NIL;
+
+        if(parent == FACT_TREE_SOA_NIL)
+            continue;
+
+        uint32_t up = jump[parent];
+
+        depth[i] = depth[parent] + 1;
+        jump[i]  = parent;
+
+        if(up != FACT_TREE_SOA_NIL && jump[up] != FACT_TREE_SOA_NIL
+                && depth[parent] - depth[up] == depth[up] - depth[jump[up]])
+            jump[i] = jump[up];
+    }
+}
+
+fact_tree_err_t fact_tree_fwrite_cpp(fact_tree_t* ftree, const char* filename)
+{
+    utils_assert(ftree);
+    utils_assert(filename);
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    fact_tree_node_t** order = NULL;
+    fact_tree_soa_link_t* links = NULL;
+    uint32_t* depth = NULL;
+    uint32_t* jump = NULL;
+    size_t size = 0;
+
+    wbuf_t wbuf = {};
+
+    BEGIN {
+        // parents ahead of children, the same as binary databases
+        err = fact_tree_layout_order(ftree, ftree->layout, &order, &links, &size);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        depth = TYPED_CALLOC(size ? size : 1, uint32_t);
+        jump  = TYPED_CALLOC(size ? size : 1, uint32_t);
+
+        if(!depth || !jump) {
+            err = FACT_TREE_ALLOC_FAIL;
+            GOTO_END;
+        }
+
+        fact_tree_cpp_link_(links, size, depth, jump);
+
+        wbuf_err_t wbuf_err = wbuf_open(&wbuf, filename);
+
+        if(wbuf_err == WBUF_ERR_NONE) {
+            const char* source = ftree->lazy.fname ? ftree->lazy.fname
+                               : ftree->journal.db_fname ? ftree->journal.db_fname
+                               : "";
+
+            WBUF_PUT_LITERAL(&wbuf, "// Generated by exyst --to-cpp from ");
+            wbuf_put(&wbuf, source, strlen(source));
+            WBUF_PUT_LITERAL(&wbuf, ", do not edit\n\n");
+
+            WBUF_PUT_LITERAL(&wbuf, "#include \"fact_tree_embed.h\"\n\n");
+            WBUF_PUT_LITERAL(&wbuf, "#pragma GCC diagnostic ignored \"-Wlarger-than=\"\n\n");
+
+            // names too long to be inline, one literal per name
+            WBUF_PUT_LITERAL(&wbuf, "static constexpr char strtab_[] =\n");
+            WBUF_PUT_LITERAL(&wbuf, "    \"\"");
+
+            for(size_t i = 0; i < size; ++i) {
+                if(order[i]->name_len <= FACT_TREE_NAME_INLINE)
+                    continue;
+
+                WBUF_PUT_LITERAL(&wbuf, "\n    ");
+                fact_tree_cpp_put_string_(&wbuf, fact_tree_node_name(order[i]), order[i]->name_len);
+            }
+
+            WBUF_PUT_LITERAL(&wbuf, ";\n\n");
+
+            fact_tree_cpp_printf_(&wbuf, "static fact_tree_node_t nodes_[%zu] =\n{\n", size ? size : 1);
+
+            size_t strtab_size = 0;
+
+            for(size_t i = 0; i < size; ++i) {
+                const fact_tree_node_t* node = order[i];
+
+                WBUF_PUT_LITERAL(&wbuf, "    { .name = { ");
+
+                if(node->name_len <= FACT_TREE_NAME_INLINE) {
+                    WBUF_PUT_LITERAL(&wbuf, ".buf = ");
+                    fact_tree_cpp_put_inline_(&wbuf, fact_tree_node_name(node), node->name_len);
+                }
+                else {
+                    fact_tree_cpp_printf_(&wbuf, ".str = const_cast<char*>(strtab_ + %zu)", strtab_size);
+                    strtab_size += node->name_len;
+                }
+
+                fact_tree_cpp_printf_(&wbuf, " }, .name_len = %zu, .depth = %u", node->name_len, depth[i]);
+
+                fact_tree_cpp_put_link_(&wbuf, "left",   links[i].left);
+                fact_tree_cpp_put_link_(&wbuf, "right",  links[i].right);
+                fact_tree_cpp_put_link_(&wbuf, "parent", links[i].parent);
+                fact_tree_cpp_put_link_(&wbuf, "jump",   jump[i]);
+
+                WBUF_PUT_LITERAL(&wbuf, " },\n");
+            }
+
+            WBUF_PUT_LITERAL(&wbuf, "};\n\n");
+
+            WBUF_PUT_LITERAL(&wbuf, "const fact_tree_embed_t fact_tree_embedded =\n{\n");
+            WBUF_PUT_LITERAL(&wbuf, "    .nodes = nodes_,\n");
+            fact_tree_cpp_printf_(&wbuf, "    .size = %zu,\n", size);
+            WBUF_PUT_LITERAL(&wbuf, "    .source = ");
+            fact_tree_cpp_put_string_(&wbuf, source, strlen(source));
+            WBUF_PUT_LITERAL(&wbuf, "\n};\n");
+
+            wbuf_err = wbuf_commit(&wbuf);
+        }
+
+        if(wbuf_err != WBUF_ERR_NONE) {
+            UTILS_LOGE(LOG_CATEGORY_EMBED, "%s: %s: %s", filename, wbuf_strerr(wbuf_err), strerror(errno));
+            err = wbuf_err == WBUF_ALLOC_FAIL ? FACT_TREE_ALLOC_FAIL : FACT_TREE_IO_ERR;
+            GOTO_END;
+        }
+
+        UTILS_LOGD(LOG_CATEGORY_EMBED, "%s: %zu nodes written as C++", filename, size);
+
+    } END;
+
+    NFREE(order);
+    NFREE(links);
+    NFREE(depth);
+    NFREE(jump);
+
+    return err;
+}
+
+#undef LOG_CATEGORY_EMBED
+#undef LINE_MAX_LEN_
@@ -0,0 +1,145 @@
+#include "fact_tree_index.h"
+
+#include <string.h>
+
+#include "memutils.h"
+#include "assertutils.h"
+#include "memstat.h"
+
+#define INDEX_INIT_CAPACITY_ 64
+
+static fact_tree_err_t fact_tree_index_reserve_heads_(fact_tree_index_t* index, size_t heads_size)
+{
+    if(heads_size <= index->heads_size)
+        return FACT_TREE_ERR_NONE;
+
+    if(heads_size < index->heads_size * 2)
+        heads_size = index->heads_size * 2;
+
+    uint32_t* heads = (uint32_t*) realloc(index->heads, heads_size * sizeof(heads[0]));
+    heads verified(return FACT_TREE_ALLOC_FAIL);
+
+    memstat_resize(MEMSTAT_INDEX, index->heads_size * sizeof(heads[0]), heads_size * sizeof(heads[0]));
+
+    // every byte of FACT_TREE_INDEX_NIL is 0xff
+    memset(heads + index->heads_size, 0xff, (heads_size - index->heads_size) * sizeof(heads[0]));
+
+    index->heads      = heads;
+    index->heads_size = heads_size;
+
+    return FACT_TREE_ERR_NONE;
+}
+
+static fact_tree_err_t fact_tree_index_reserve_(fact_tree_index_t* index, size_t capacity)
+{
+    if(capacity <= index->capacity)
+        return FACT_TREE_ERR_NONE;
+
+    if(capacity < index->capacity * 2)
+        capacity = index->capacity * 2;
+
+    fact_tree_node_t** leaves = (fact_tree_node_t**) realloc(index->leaves, capacity * sizeof(leaves[0]));
+    leaves verified(return FACT_TREE_ALLOC_FAIL);
+    index->leaves = leaves;
+
+    uint32_t* prev = (uint32_t*) realloc(index->prev, capacity * sizeof(prev[0]));
+    prev verified(return FACT_TREE_ALLOC_FAIL);
+    index->prev = prev;
+
+    // accounted once both arrays have grown
+    memstat_resize(
+        MEMSTAT_INDEX,
+        index->capacity * (sizeof(leaves[0]) + sizeof(prev[0])),
+        capacity * (sizeof(leaves[0]) + sizeof(prev[0]))
+    );
+
+    index->capacity = capacity;
+
+    return FACT_TREE_ERR_NONE;
+}
+
+fact_tree_err_t fact_tree_index_build(fact_tree_index_t* index, const fact_tree_soa_t* soa, size_t names_size)
+{
+    utils_assert(index);
+    utils_assert(soa);
+
+    memset(index, 0, sizeof(*index));
+
+    // a full tree has one leaf more than it has questions
+    fact_tree_err_t err = fact_tree_index_reserve_heads_(index, names_size);
+    if(err == FACT_TREE_ERR_NONE)
+        err = fact_tree_index_reserve_(index, soa->size / 2 + 1);
+
+    for(size_t i = 0; i < soa->size && err == FACT_TREE_ERR_NONE; ++i) {
+        const fact_tree_soa_link_t* link = &soa->links[i];
+
+        if(link->left == FACT_TREE_SOA_NIL && link->right == FACT_TREE_SOA_NIL)
+            err = fact_tree_index_add(index, soa->nodes[i]);
+    }
+
+    if(err != FACT_TREE_ERR_NONE)
+        fact_tree_index_dtor(index);
+
+    return err;
+}
+
+void fact_tree_index_dtor(fact_tree_index_t* index)
+{
+    utils_assert(index);
+
+    if(index->heads_size)
+        memstat_free(MEMSTAT_INDEX, index->heads_size * sizeof(index->heads[0]));
+
+    if(index->capacity)
+        memstat_free(MEMSTAT_INDEX, index->capacity * (sizeof(index->leaves[0]) + sizeof(index->prev[0])));
+
+    NFREE(index->heads);
+    NFREE(index->leaves);
+    NFREE(index->prev);
+
+    index->heads_size = 0;
+    index->size       = 0;
+    index->capacity   = 0;
+}
+
+fact_tree_err_t fact_tree_index_add(fact_tree_index_t* index, fact_tree_node_t* leaf)
+{
+    utils_assert(index);
+    utils_assert(leaf);
+    utils_assert(leaf->name_id != STR_POOL_NONE);
+
+    fact_tree_err_t err = fact_tree_index_reserve_heads_(index, (size_t) leaf->name_id + 1);
+    err == FACT_TREE_ERR_NONE verified(return err);
+
+    err = fact_tree_index_reserve_(index, index->size ? index->size + 1 : INDEX_INIT_CAPACITY_);
+    err == FACT_TREE_ERR_NONE verified(return err);
+
+    uint32_t entry = (uint32_t) index->size++;
+
+    index->leaves[entry]        = leaf;
+    index->prev[entry]          = index->heads[leaf->name_id];
+    index->heads[leaf->name_id] = entry;
+
+    return FACT_TREE_ERR_NONE;
+}
+
+int fact_tree_index_replace(fact_tree_index_t* index, const fact_tree_node_t* leaf, fact_tree_node_t* node)
+{
+    utils_assert(index);
+    utils_assert(leaf);
+    utils_assert(node);
+
+    uint32_t entry = fact_tree_index_last(index, node->name_id);
+
+    while(entry != FACT_TREE_INDEX_NIL && index->leaves[entry] != leaf)
+        entry = fact_tree_index_prev(index, entry);
+
+    if(entry == FACT_TREE_INDEX_NIL)
+        return 0;
+
+    index->leaves[entry] = node;
+
+    return 1;
+}
+
+#undef INDEX_INIT_CAPACITY_
@@ -0,0 +1,284 @@
+#include "fact_tree_layout.h"
+
+#include <string.h>
+
+#include "utils.h"
+#include "memutils.h"
+#include "assertutils.h"
+
+#define LAYOUT_INIT_CAPACITY_ 64
+
+static fact_tree_err_t fact_tree_layout_reserve_(
+    fact_tree_node_t*** order,
+    fact_tree_soa_link_t** links,
+    size_t* capacity,
+    size_t needed)
+{
+    if(needed <= *capacity)
+        return FACT_TREE_ERR_NONE;
+
+    size_t capacity_new = *capacity ? *capacity : LAYOUT_INIT_CAPACITY_;
+    while(capacity_new < needed)
+        capacity_new *= 2;
+
+    fact_tree_node_t** order_new =
+        (fact_tree_node_t**) realloc(*order, capacity_new * sizeof(order_new[0]));
+    order_new verified(return FACT_TREE_ALLOC_FAIL);
+    *order = order_new;
+
+    fact_tree_soa_link_t* links_new =
+        (fact_tree_soa_link_t*) realloc(*links, capacity_new * sizeof(links_new[0]));
+    links_new verified(return FACT_TREE_ALLOC_FAIL);
+    *links = links_new;
+
+    *capacity = capacity_new;
+
+    return FACT_TREE_ERR_NONE;
+}
+
+// The queue is the output order itself, children
+// get the next free numbers when their parent is dequeued
+static fact_tree_err_t fact_tree_layout_bfs_(
+    fact_tree_t* ftree,
+    fact_tree_node_t*** order,
+    fact_tree_soa_link_t** links,
+    size_t* size)
+{
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    size_t capacity = 0, count = 0;
+
+    if(ftree->root) {
+        err = fact_tree_layout_reserve_(order, links, &capacity, 1);
+        err == FACT_TREE_ERR_NONE verified(return err);
+
+        (*order)[count] = ftree->root;
+        (*links)[count].parent = FACT_TREE_SOA_NIL;
+        ++count;
+    }
+
+    for(size_t i = 0; i < count; ++i) {
+        // numbers must stay below FACT_TREE_SOA_NIL
+        if(count + 2 > FACT_TREE_SOA_NIL) {
+            err = FACT_TREE_FORMAT_ERR;
+            break;
+        }
+
+        err = fact_tree_layout_reserve_(order, links, &capacity, count + 2);
+        if(err != FACT_TREE_ERR_NONE)
+            break;
+
+        fact_tree_node_t* node = (*order)[i];
+        fact_tree_soa_link_t* link = &(*links)[i];
+
+        link->left = link->right = FACT_TREE_SOA_NIL;
+
+        err = fact_tree_expand(ftree, node);
+        if(err != FACT_TREE_ERR_NONE)
+            break;
+
+        fact_tree_node_t* left  = node->left;
+        fact_tree_node_t* right = node->right;
+
+        if(left) {
+            link->left = (uint32_t) count;
+            (*links)[count].parent = (uint32_t) i;
+            (*order)[count++] = left;
+        }
+
+        if(right) {
+            link->right = (uint32_t) count;
+            (*links)[count].parent = (uint32_t) i;
+            (*order)[count++] = right;
+        }
+    }
+
+    *size = count;
+
+    return err;
+}
+
+typedef struct fact_tree_layout_frame_t
+{
+    uint32_t id;
+    size_t depth;
+} fact_tree_layout_frame_t;
+
+typedef struct fact_tree_layout_veb_t
+{
+    const fact_tree_soa_link_t* links;
+    uint32_t* rank;
+    uint32_t next;
+
+    // shared by all levels of the recursion, every
+    // call pops back down to where it started
+    fact_tree_layout_frame_t* frames;
+    size_t frames_size;
+    size_t frames_capacity;
+} fact_tree_layout_veb_t;
+
+static fact_tree_err_t fact_tree_layout_veb_push_(fact_tree_layout_veb_t* veb, uint32_t id, size_t depth)
+{
+    if(veb->frames_size == veb->frames_capacity) {
+        size_t capacity = veb->frames_capacity ? veb->frames_capacity * 2 : LAYOUT_INIT_CAPACITY_;
+
+        fact_tree_layout_frame_t* frames =
+            (fact_tree_layout_frame_t*) realloc(veb->frames, capacity * sizeof(frames[0]));
+        frames verified(return FACT_TREE_ALLOC_FAIL);
+
+        veb->frames          = frames;
+        veb->frames_capacity = capacity;
+    }
+
+    veb->frames[veb->frames_size++] = { .id = id, .depth = depth };
+
+    return FACT_TREE_ERR_NONE;
+}
+
+// Ranks the subtree of root cut height levels deep: its top half of
+// levels goes first, then every subtree hanging below it, left to right,
+// each laid out the same way. Recursion depth is logarithmic in height
+static fact_tree_err_t fact_tree_layout_veb_(fact_tree_layout_veb_t* veb, uint32_t root, size_t height)
+{
+    if(height == 1) {
+        veb->rank[root] = veb->next++;
+        return FACT_TREE_ERR_NONE;
+    }
+
+    size_t top = height / 2;
+
+    fact_tree_err_t err = fact_tree_layout_veb_(veb, root, top);
+    err == FACT_TREE_ERR_NONE verified(return err);
+
+    size_t base = veb->frames_size;
+
+    err = fact_tree_layout_veb_push_(veb, root, 0);
+
+    while(err == FACT_TREE_ERR_NONE && veb->frames_size > base) {
+        fact_tree_layout_frame_t frame = veb->frames[--veb->frames_size];
+
+        if(frame.depth == top) {
+            err = fact_tree_layout_veb_(veb, frame.id, height - top);
+            continue;
+        }
+
+        const fact_tree_soa_link_t* link = &veb->links[frame.id];
+
+        // right goes first so that the left subtree is popped first
+        if(link->right != FACT_TREE_SOA_NIL)
+            err = fact_tree_layout_veb_push_(veb, link->right, frame.depth + 1);
+
+        if(err == FACT_TREE_ERR_NONE && link->left != FACT_TREE_SOA_NIL)
+            err = fact_tree_layout_veb_push_(veb, link->left, frame.depth + 1);
+    }
+
+    veb->frames_size = base;
+
+    return err;
+}
+
+static uint32_t fact_tree_layout_remap_(const uint32_t* rank, uint32_t id)
+{
+    return id != FACT_TREE_SOA_NIL ? rank[id] : FACT_TREE_SOA_NIL;
+}
+
+// Renumbers a BFS numbering in van Emde Boas order
+static fact_tree_err_t fact_tree_layout_veb_order_(
+    fact_tree_node_t*** order,
+    fact_tree_soa_link_t** links,
+    size_t size)
+{
+    if(size == 0)
+        return FACT_TREE_ERR_NONE;
+
+    // the last node in BFS order is one of the deepest
+    size_t height = 1;
+    for(uint32_t id = (uint32_t)(size - 1); (*links)[id].parent != FACT_TREE_SOA_NIL; id = (*links)[id].parent)
+        ++height;
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    fact_tree_layout_veb_t veb = {
+        .links           = *links,
+        .rank            = TYPED_CALLOC(size, uint32_t),
+        .next            = 0,
+        .frames          = NULL,
+        .frames_size     = 0,
+        .frames_capacity = 0
+    };
+
+    fact_tree_node_t** order_new = TYPED_CALLOC(size, fact_tree_node_t*);
+    fact_tree_soa_link_t* links_new = TYPED_CALLOC(size, fact_tree_soa_link_t);
+
+    BEGIN {
+        if(!veb.rank || !order_new || !links_new) {
+            err = FACT_TREE_ALLOC_FAIL;
+            GOTO_END;
+        }
+
+        err = fact_tree_layout_veb_(&veb, 0, height);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        utils_assert(veb.next == size);
+
+        for(size_t i = 0; i < size; ++i) {
+            const fact_tree_soa_link_t* link = &(*links)[i];
+
+            order_new[veb.rank[i]] = (*order)[i];
+            links_new[veb.rank[i]] = {
+                .left   = fact_tree_layout_remap_(veb.rank, link->left),
+                .right  = fact_tree_layout_remap_(veb.rank, link->right),
+                .parent = fact_tree_layout_remap_(veb.rank, link->parent)
+            };
+        }
+
+        NFREE(*order);
+        NFREE(*links);
+
+        *order = order_new;
+        *links = links_new;
+
+        order_new = NULL;
+        links_new = NULL;
+
+    } END;
+
+    NFREE(veb.rank);
+    NFREE(veb.frames);
+    NFREE(order_new);
+    NFREE(links_new);
+
+    return err;
+}
+
+fact_tree_err_t fact_tree_layout_order(
+    fact_tree_t* ftree,
+    fact_tree_layout_t layout,
+    fact_tree_node_t*** order,
+    fact_tree_soa_link_t** links,
+    size_t* size)
+{
+    utils_assert(ftree);
+    utils_assert(order);
+    utils_assert(links);
+    utils_assert(size);
+
+    *order = NULL;
+    *links = NULL;
+    *size  = 0;
+
+    fact_tree_err_t err = fact_tree_layout_bfs_(ftree, order, links, size);
+
+    if(err == FACT_TREE_ERR_NONE && layout == FACT_TREE_LAYOUT_VEB)
+        err = fact_tree_layout_veb_order_(order, links, *size);
+
+    if(err != FACT_TREE_ERR_NONE) {
+        NFREE(*order);
+        NFREE(*links);
+        *size = 0;
+    }
+
+    return err;
+}
+
+#undef LAYOUT_INIT_CAPACITY_
@@ -0,0 +1,606 @@
+#include "fact_tree_pages.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "logutils.h"
+#include "memutils.h"
+#include "assertutils.h"
+
+#define LOG_CATEGORY_PAGES "PAGES"
+
+int fact_tree_pages_magic(const char* magic)
+{
+    return memcmp(magic, FACT_TREE_PAGES_MAGIC, sizeof(FACT_TREE_PAGES_MAGIC) - 1) == 0;
+}
+
+static fact_tree_pages_header_t* fact_tree_pages_header_(page_store_t* store, int dirty)
+{
+    return (fact_tree_pages_header_t*) page_store_get(store, 0, dirty);
+}
+
+// Returns the page holding cell if it is a used cell of a page of that kind
+static char* fact_tree_pages_cell_page_(page_store_t* store, uint32_t cell, uint32_t cells, uint32_t kind, int dirty)
+{
+    uint32_t slot = cell % FACT_TREE_PAGES_CELLS_PER_PAGE;
+
+    char* page = page_store_get(store, cell / FACT_TREE_PAGES_CELLS_PER_PAGE, dirty);
+    if(!page)
+        return NULL;
+
+    const fact_tree_page_header_t* page_header = (const fact_tree_page_header_t*) page;
+
+    if(page_header->kind != kind || slot == 0 || slot + cells > page_header->cells_used)
+        return NULL;
+
+    return page;
+}
+
+static fact_tree_err_t fact_tree_pages_read_node_(page_store_t* store, uint32_t cell, fact_tree_page_node_t* rec)
+{
+    char* page = fact_tree_pages_cell_page_(store, cell, 1, FACT_TREE_PAGE_NODES, 0);
+    if(!page)
+        return FACT_TREE_FORMAT_ERR;
+
+    memcpy(rec, page + (cell % FACT_TREE_PAGES_CELLS_PER_PAGE) * FACT_TREE_PAGES_CELL_SIZE, sizeof(*rec));
+
+    return FACT_TREE_ERR_NONE;
+}
+
+static fact_tree_err_t fact_tree_pages_write_node_(page_store_t* store, uint32_t cell, const fact_tree_page_node_t* rec)
+{
+    char* page = fact_tree_pages_cell_page_(store, cell, 1, FACT_TREE_PAGE_NODES, 1);
+    if(!page)
+        return FACT_TREE_IO_ERR;
+
+    memcpy(page + (cell % FACT_TREE_PAGES_CELLS_PER_PAGE) * FACT_TREE_PAGES_CELL_SIZE, rec, sizeof(*rec));
+
+    return FACT_TREE_ERR_NONE;
+}
+
+static uint32_t fact_tree_pages_name_cells_(size_t len)
+{
+    return (uint32_t)((len + FACT_TREE_PAGES_CELL_SIZE - 1) / FACT_TREE_PAGES_CELL_SIZE);
+}
+
+// Returns the name inside its page, valid until the next call on the store
+static const char* fact_tree_pages_name_(page_store_t* store, const fact_tree_page_node_t* rec)
+{
+    if(rec->name_len == 0)
+        return "";
+
+    char* page = fact_tree_pages_cell_page_(
+        store, rec->name_cell, fact_tree_pages_name_cells_(rec->name_len), FACT_TREE_PAGE_NAMES, 0);
+
+    if(!page)
+        return NULL;
+
+    return page + (rec->name_cell % FACT_TREE_PAGES_CELLS_PER_PAGE) * FACT_TREE_PAGES_CELL_SIZE;
+}
+
+// Takes cells consecutive cells from the last page of that kind,
+// a new page is appended when they do not fit
+static fact_tree_err_t fact_tree_pages_alloc_(page_store_t* store, uint32_t kind, uint32_t cells, uint32_t* cell)
+{
+    fact_tree_pages_header_t* header = fact_tree_pages_header_(store, 0);
+    header verified(return FACT_TREE_IO_ERR);
+
+    uint64_t page_no = kind == FACT_TREE_PAGE_NODES ? header->nodes_page : header->names_page;
+
+    fact_tree_page_header_t* page_header = NULL;
+
+    if(page_no != 0) {
+        page_header = (fact_tree_page_header_t*) page_store_get(store, page_no, 1);
+        page_header verified(return FACT_TREE_IO_ERR);
+    }
+
+    if(!page_header || page_header->cells_used + cells > FACT_TREE_PAGES_CELLS_PER_PAGE) {
+        if(store->page_count >= FACT_TREE_PAGES_NIL / FACT_TREE_PAGES_CELLS_PER_PAGE)
+            return FACT_TREE_FORMAT_ERR;
+
+        page_store_append(store, &page_no) == PAGE_STORE_ERR_NONE verified(return FACT_TREE_IO_ERR);
+
+        page_header = (fact_tree_page_header_t*) page_store_get(store, page_no, 1);
+        page_header verified(return FACT_TREE_IO_ERR);
+
+        page_header->kind       = kind;
+        page_header->cells_used = 1;
+
+        header = fact_tree_pages_header_(store, 1);
+        header verified(return FACT_TREE_IO_ERR);
+
+        if(kind == FACT_TREE_PAGE_NODES)
+            header->nodes_page = (uint32_t) page_no;
+        else
+            header->names_page = (uint32_t) page_no;
+
+        page_header = (fact_tree_page_header_t*) page_store_get(store, page_no, 1);
+        page_header verified(return FACT_TREE_IO_ERR);
+    }
+
+    *cell = (uint32_t)(page_no * FACT_TREE_PAGES_CELLS_PER_PAGE) + page_header->cells_used;
+    page_header->cells_used += cells;
+
+    return FACT_TREE_ERR_NONE;
+}
+
+static fact_tree_err_t fact_tree_pages_write_name_(page_store_t* store, const fact_tree_node_t* node, uint32_t* cell)
+{
+    if(node->name_len > FACT_TREE_PAGES_NAME_MAX)
+        return FACT_TREE_FORMAT_ERR;
+
+    *cell = FACT_TREE_PAGES_NIL;
+
+    if(node->name_len == 0)
+        return FACT_TREE_ERR_NONE;
+
+    uint32_t cells = fact_tree_pages_name_cells_(node->name_len);
+
+    fact_tree_err_t err = fact_tree_pages_alloc_(store, FACT_TREE_PAGE_NAMES, cells, cell);
+    if(err != FACT_TREE_ERR_NONE)
+        return err;
+
+    char* page = fact_tree_pages_cell_page_(store, *cell, cells, FACT_TREE_PAGE_NAMES, 1);
+    page verified(return FACT_TREE_IO_ERR);
+
+    memcpy(page + (*cell % FACT_TREE_PAGES_CELLS_PER_PAGE) * FACT_TREE_PAGES_CELL_SIZE, fact_tree_node_name(node), node->name_len);
+
+    return FACT_TREE_ERR_NONE;
+}
+
+static fact_tree_err_t fact_tree_pages_node_(fact_tree_t* ftree, uint32_t cell, fact_tree_node_t** node)
+{
+    fact_tree_page_node_t rec = {};
+    const char* page_name = NULL;
+
+    fact_tree_err_t err = fact_tree_pages_read_node_(ftree->lazy.store, cell, &rec);
+
+    if(err == FACT_TREE_ERR_NONE) {
+        page_name = fact_tree_pages_name_(ftree->lazy.store, &rec);
+        if(!page_name)
+            err = FACT_TREE_FORMAT_ERR;
+    }
+
+    if(err == FACT_TREE_FORMAT_ERR)
+        UTILS_LOGE(LOG_CATEGORY_PAGES, "%s: invalid node cell %u", ftree->lazy.fname, cell);
+
+    if(err != FACT_TREE_ERR_NONE)
+        return err;
+
+    // copied out, the page may be evicted by the next read
+    err = fact_tree_copy_name(ftree, page_name, rec.name_len, node);
+    if(err != FACT_TREE_ERR_NONE)
+        return err;
+
+    (*node)->lazy      = 1;
+    (*node)->lazy_id   = cell;
+
+    return FACT_TREE_ERR_NONE;
+}
+
+fact_tree_err_t fact_tree_pages_expand(fact_tree_t* ftree, fact_tree_node_t* node)
+{
+    fact_tree_page_node_t rec = {};
+
+    fact_tree_err_t err = fact_tree_pages_read_node_(ftree->lazy.store, (uint32_t) node->lazy_id, &rec);
+    if(err != FACT_TREE_ERR_NONE)
+        return err;
+
+    uint32_t cells[] = { rec.left, rec.right };
+    fact_tree_node_t** children[] = { &node->left, &node->right };
+
+    for(size_t i = 0; i < SIZEOF(children); ++i) {
+        if(cells[i] == FACT_TREE_PAGES_NIL)
+            continue;
+
+        err = fact_tree_pages_node_(ftree, cells[i], children[i]);
+        if(err != FACT_TREE_ERR_NONE)
+            return err;
+
+        (*children[i])->parent = node;
+    }
+
+    return FACT_TREE_ERR_NONE;
+}
+
+// Nothing but the header and the root is read here, pages
+// come through the buffer pool as nodes are expanded
+fact_tree_err_t fact_tree_fread_pages(fact_tree_t* ftree, const char* filename, size_t pool_size)
+{
+    utils_assert(ftree);
+    utils_assert(filename);
+
+    fact_tree_dtor(ftree);
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    ftree->lazy.fname = strdup(filename);
+    ftree->lazy.store = TYPED_CALLOC(1, page_store_t);
+
+    if(!ftree->lazy.fname || !ftree->lazy.store) {
+        NFREE(ftree->lazy.fname);
+        NFREE(ftree->lazy.store);
+        return FACT_TREE_ALLOC_FAIL;
+    }
+
+    // a file the user cannot write is still browsed, inserts into it fail
+    page_store_mode_t mode = access(filename, W_OK) == 0 ? PAGE_STORE_WRITE : PAGE_STORE_READ;
+
+    page_store_err_t store_err = page_store_open(ftree->lazy.store, filename, pool_size, mode);
+    if(store_err != PAGE_STORE_ERR_NONE) {
+        UTILS_LOGE(LOG_CATEGORY_PAGES, "%s: %s: %s", filename, page_store_strerr(store_err), strerror(errno));
+        NFREE(ftree->lazy.fname);
+        NFREE(ftree->lazy.store);
+        return store_err == PAGE_STORE_ALLOC_FAIL ? FACT_TREE_ALLOC_FAIL : FACT_TREE_IO_ERR;
+    }
+
+    ftree->lazy.mode = FACT_TREE_LAZY_PAGED;
+
+    const fact_tree_pages_header_t* header = fact_tree_pages_header_(ftree->lazy.store, 0);
+
+    if(!header || !fact_tree_pages_magic(header->magic) || header->version != FACT_TREE_PAGES_VERSION) {
+        UTILS_LOGE(LOG_CATEGORY_PAGES, "%s: not a paged database of version %u", filename, FACT_TREE_PAGES_VERSION);
+        return FACT_TREE_FORMAT_ERR;
+    }
+
+    ftree->size = header->node_count;
+
+    if(header->root != FACT_TREE_PAGES_NIL)
+        err = fact_tree_pages_node_(ftree, header->root, &ftree->root);
+
+    UTILS_LOGD(
+        LOG_CATEGORY_PAGES, 
+        "%s: opened %zu nodes in %lu pages, pool of %zu pages", 
+        filename, 
+        ftree->size, 
+        ftree->lazy.store->page_count, 
+        ftree->lazy.store->frames_capacity
+    );
+
+    return err;
+}
+
+void fact_tree_pages_close(fact_tree_t* ftree)
+{
+    page_store_t* store = ftree->lazy.store;
+
+    page_store_err_t err = page_store_close(store);
+    if(err != PAGE_STORE_ERR_NONE)
+        UTILS_LOGE(LOG_CATEGORY_PAGES, "%s: %s", ftree->lazy.fname, page_store_strerr(err));
+
+    const page_store_stats_t* stats = &store->stats;
+    uint64_t accesses = stats->hits + stats->misses;
+
+    UTILS_LOGD(
+        LOG_CATEGORY_PAGES, 
+        "%s: page pool: %lu hits, %lu misses (%.1f%% hit rate), %lu evictions, %lu writebacks", 
+        ftree->lazy.fname, 
+        stats->hits, 
+        stats->misses, 
+        accesses ? 100.0 * (double) stats->hits / (double) accesses : 0.0,
+        stats->evictions, 
+        stats->writebacks
+    );
+
+    NFREE(ftree->lazy.store);
+}
+
+static fact_tree_err_t fact_tree_pages_flush_(fact_tree_t* ftree)
+{
+    if(page_store_flush(ftree->lazy.store) == PAGE_STORE_ERR_NONE)
+        return FACT_TREE_ERR_NONE;
+
+    UTILS_LOGE(LOG_CATEGORY_PAGES, "%s: %s", ftree->lazy.fname, strerror(errno));
+
+    return FACT_TREE_IO_ERR;
+}
+
+fact_tree_err_t fact_tree_pages_insert(fact_tree_t* ftree, const fact_tree_node_t* node, fact_tree_node_t* question, fact_tree_node_t* added)
+{
+    page_store_t* store = ftree->lazy.store;
+
+    uint32_t cell = (uint32_t) node->lazy_id;
+
+    fact_tree_page_node_t rec = {}, rec_old = {}, rec_added = {};
+
+    fact_tree_err_t err = fact_tree_pages_read_node_(store, cell, &rec);
+    if(err != FACT_TREE_ERR_NONE)
+        return err;
+
+    uint32_t old_cell = 0, added_cell = 0;
+
+    BEGIN {
+        rec_old.left      = rec_old.right   = FACT_TREE_PAGES_NIL;
+        rec_added.left    = rec_added.right = FACT_TREE_PAGES_NIL;
+        rec_old.parent    = rec_added.parent = cell;
+        rec_old.name_len  = rec.name_len;
+        rec_old.name_cell = rec.name_cell;
+
+        rec.name_len       = (uint32_t) question->name_len;
+        rec_added.name_len = (uint32_t) added->name_len;
+
+        err = fact_tree_pages_write_name_(store, question, &rec.name_cell);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        err = fact_tree_pages_write_name_(store, added, &rec_added.name_cell);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        err = fact_tree_pages_alloc_(store, FACT_TREE_PAGE_NODES, 1, &old_cell);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        err = fact_tree_pages_alloc_(store, FACT_TREE_PAGE_NODES, 1, &added_cell);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        rec.left  = old_cell;
+        rec.right = added_cell;
+
+        err = fact_tree_pages_write_node_(store, old_cell, &rec_old);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        err = fact_tree_pages_write_node_(store, added_cell, &rec_added);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        // the page of node is only read so far, an eviction
+        // may write it back but not with the new links
+        err = fact_tree_pages_flush_(ftree);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        err = fact_tree_pages_write_node_(store, cell, &rec);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        err = fact_tree_pages_flush_(ftree);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        fact_tree_pages_header_t* header = fact_tree_pages_header_(store, 1);
+        if(!header) {
+            err = FACT_TREE_IO_ERR;
+            GOTO_END;
+        }
+
+        header->node_count += 2;
+
+        err = fact_tree_pages_flush_(ftree);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        question->lazy_id = old_cell;
+        added->lazy_id    = added_cell;
+
+    } END;
+
+    if(err != FACT_TREE_ERR_NONE)
+        UTILS_LOGE(LOG_CATEGORY_PAGES, "%s: failed to store inserted nodes", ftree->lazy.fname);
+
+    return err;
+}
+
+fact_tree_node_t* fact_tree_pages_find(fact_tree_t* ftree, const char* name)
+{
+    page_store_t* store = ftree->lazy.store;
+    size_t name_len = strlen(name);
+
+    uint32_t found = FACT_TREE_PAGES_NIL;
+
+    for(uint64_t page_no = 1; found == FACT_TREE_PAGES_NIL && page_no < store->page_count; ++page_no) {
+        const fact_tree_page_header_t* page_header = (const fact_tree_page_header_t*) page_store_get(store, page_no, 0);
+
+        if(!page_header || page_header->kind != FACT_TREE_PAGE_NODES)
+            continue;
+
+        uint32_t cells_used = page_header->cells_used;
+
+        for(uint32_t slot = 1; found == FACT_TREE_PAGES_NIL && slot < cells_used; ++slot) {
+            uint32_t cell = (uint32_t)(page_no * FACT_TREE_PAGES_CELLS_PER_PAGE) + slot;
+
+            fact_tree_page_node_t rec = {};
+            if(fact_tree_pages_read_node_(store, cell, &rec) != FACT_TREE_ERR_NONE)
+                break;
+
+            if(rec.left != FACT_TREE_PAGES_NIL || rec.right != FACT_TREE_PAGES_NIL || rec.name_len != name_len)
+                continue;
+
+            const char* rec_name = fact_tree_pages_name_(store, &rec);
+
+            if(rec_name && memcmp(rec_name, name, name_len) == 0)
+                found = cell;
+        }
+    }
+
+    if(found == FACT_TREE_PAGES_NIL)
+        return NULL;
+
+    // cells from the leaf up to the root, the parent chain
+    // of a valid file is not longer than the node count
+    uint32_t* path = NULL;
+    size_t path_size = 0;
+
+    fact_tree_node_t* node = NULL;
+
+    BEGIN {
+        path = TYPED_CALLOC(ftree->size + 1, uint32_t);
+        if(!path) GOTO_END;
+
+        for(uint32_t cell = found; cell != FACT_TREE_PAGES_NIL && path_size <= ftree->size; ) {
+            path[path_size++] = cell;
+
+            fact_tree_page_node_t rec = {};
+            if(fact_tree_pages_read_node_(store, cell, &rec) != FACT_TREE_ERR_NONE) {
+                path_size = 0;
+                break;
+            }
+
+            cell = rec.parent;
+        }
+
+        if(path_size == 0 || path_size > ftree->size || !ftree->root || ftree->root->lazy_id != path[path_size - 1]) {
+            UTILS_LOGE(LOG_CATEGORY_PAGES, "%s: broken parent chain of cell %u", ftree->lazy.fname, found);
+            GOTO_END;
+        }
+
+        node = ftree->root;
+
+        for(size_t i = path_size - 1; node && i-- > 0; ) {
+            fact_tree_node_t* left  = fact_tree_node_left(ftree, node);
+            fact_tree_node_t* right = fact_tree_node_right(ftree, node);
+
+            if(left && left->lazy_id == path[i])
+                node = left;
+            else if(right && right->lazy_id == path[i])
+                node = right;
+            else
+                node = NULL;
+        }
+
+    } END;
+
+    NFREE(path);
+
+    return node;
+}
+
+typedef struct fact_tree_pages_entry_t
+{
+    fact_tree_node_t* node;
+    uint32_t cell;
+    uint32_t parent;
+} fact_tree_pages_entry_t;
+
+fact_tree_err_t fact_tree_fwrite_pages(fact_tree_t* ftree, const char* filename)
+{
+    utils_assert(ftree);
+    utils_assert(filename);
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    page_store_t store = {};
+
+    page_store_err_t store_err = page_store_open(&store, filename, FACT_TREE_PAGES_POOL_DEFAULT, PAGE_STORE_CREATE);
+    if(store_err != PAGE_STORE_ERR_NONE) {
+        UTILS_LOGE(LOG_CATEGORY_PAGES, "%s: %s: %s", filename, page_store_strerr(store_err), strerror(errno));
+        return store_err == PAGE_STORE_ALLOC_FAIL ? FACT_TREE_ALLOC_FAIL : FACT_TREE_IO_ERR;
+    }
+
+    // BFS queue, cells of children are taken when their parent is written.
+    // size only counts what was loaded, so the queue may still grow
+    fact_tree_pages_entry_t* queue = NULL;
+    size_t capacity = ftree->size + 1, count = 0;
+
+    BEGIN {
+        uint64_t header_page = 0;
+        if(page_store_append(&store, &header_page) != PAGE_STORE_ERR_NONE) {
+            err = FACT_TREE_IO_ERR;
+            GOTO_END;
+        }
+
+        fact_tree_pages_header_t* header = fact_tree_pages_header_(&store, 1);
+        if(!header) {
+            err = FACT_TREE_IO_ERR;
+            GOTO_END;
+        }
+
+        memcpy(header->magic, FACT_TREE_PAGES_MAGIC, sizeof(header->magic));
+        header->version    = FACT_TREE_PAGES_VERSION;
+        header->root       = FACT_TREE_PAGES_NIL;
+        header->node_count = 0;
+        header->nodes_page = 0;
+        header->names_page = 0;
+
+        if(!ftree->root) GOTO_END;
+
+        queue = TYPED_CALLOC(capacity, fact_tree_pages_entry_t);
+        if(!queue) {
+            err = FACT_TREE_ALLOC_FAIL;
+            GOTO_END;
+        }
+
+        queue[0].node   = ftree->root;
+        queue[0].parent = FACT_TREE_PAGES_NIL;
+
+        err = fact_tree_pages_alloc_(&store, FACT_TREE_PAGE_NODES, 1, &queue[0].cell);
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        ++count;
+
+        for(size_t i = 0; i < count; ++i) {
+            fact_tree_node_t* node = queue[i].node;
+
+            fact_tree_page_node_t rec = {};
+            rec.left     = FACT_TREE_PAGES_NIL;
+            rec.right    = FACT_TREE_PAGES_NIL;
+            rec.parent   = queue[i].parent;
+            rec.name_len = (uint32_t) node->name_len;
+
+            err = fact_tree_pages_write_name_(&store, node, &rec.name_cell);
+            if(err != FACT_TREE_ERR_NONE) {
+                UTILS_LOGE(LOG_CATEGORY_PAGES, "%s: cannot store name of %zu bytes", filename, node->name_len);
+                break;
+            }
+
+            err = fact_tree_expand(ftree, node);
+            if(err != FACT_TREE_ERR_NONE)
+                break;
+
+            fact_tree_node_t* children[] = { node->left, node->right };
+            uint32_t* links[] = { &rec.left, &rec.right };
+
+            for(size_t j = 0; err == FACT_TREE_ERR_NONE && j < SIZEOF(children); ++j) {
+                if(!children[j])
+                    continue;
+
+                if(count == capacity) {
+                    fact_tree_pages_entry_t* queue_new = 
+                        (fact_tree_pages_entry_t*) realloc(queue, 2 * capacity * sizeof(queue[0]));
+                    if(!queue_new) {
+                        err = FACT_TREE_ALLOC_FAIL;
+                        break;
+                    }
+                    queue     = queue_new;
+                    capacity *= 2;
+                }
+
+                queue[count].node   = children[j];
+                queue[count].parent = queue[i].cell;
+
+                err = fact_tree_pages_alloc_(&store, FACT_TREE_PAGE_NODES, 1, &queue[count].cell);
+
+                *links[j] = queue[count++].cell;
+            }
+
+            if(err == FACT_TREE_ERR_NONE)
+                err = fact_tree_pages_write_node_(&store, queue[i].cell, &rec);
+
+            if(err != FACT_TREE_ERR_NONE) break;
+        }
+
+        if(err != FACT_TREE_ERR_NONE) GOTO_END;
+
+        header = fact_tree_pages_header_(&store, 1);
+        if(!header) {
+            err = FACT_TREE_IO_ERR;
+            GOTO_END;
+        }
+
+        header->root       = queue[0].cell;
+        header->node_count = count;
+
+    } END;
+
+    NFREE(queue);
+
+    // the pages are built under a temporary name, a failed
+    // or interrupted write leaves the old database as it was
+    if(err != FACT_TREE_ERR_NONE) {
+        page_store_close(&store);
+        return err;
+    }
+
+    store_err = page_store_commit(&store);
+    if(store_err != PAGE_STORE_ERR_NONE) {
+        UTILS_LOGE(LOG_CATEGORY_PAGES, "%s: %s: %s", filename, page_store_strerr(store_err), strerror(errno));
+        return FACT_TREE_IO_ERR;
+    }
+
+    UTILS_LOGD(LOG_CATEGORY_PAGES, "%s: wrote %zu nodes in %lu pages", filename, count, store.page_count);
+
+    return FACT_TREE_ERR_NONE;
+}
@@ -0,0 +1,316 @@
+#include "fact_tree_query.h"
+
+#include <string.h>
+
+#include "memutils.h"
+#include "assertutils.h"
+#include "memstat.h"
+
+#define QUERY_INIT_CAPACITY_ 16
+
+static int fact_tree_attrs_is_leaf_(const fact_tree_soa_link_t* link)
+{
+    return link->left == FACT_TREE_SOA_NIL && link->right == FACT_TREE_SOA_NIL;
+}
+
+static fact_tree_attrs_range_t fact_tree_attrs_range_(const uint32_t* first, const uint32_t* last, uint32_t node)
+{
+    if(node == FACT_TREE_SOA_NIL)
+        return { .first = 0, .last = 0 };
+
+    return { .first = first[node], .last = last[node] };
+}
+
+static size_t fact_tree_attrs_bytes_(const fact_tree_attrs_t* attrs)
+{
+    return attrs->leaves_size    * sizeof(attrs->leaves[0])
+         + (attrs->names_size + 1) * sizeof(attrs->offsets[0])
+         + attrs->questions_size * sizeof(attrs->questions[0]);
+}
+
+// A node is numbered after the leaves before it in preorder and its
+// subtree ends where the subtree of its last child does, so one pass
+// forward and one backward number every subtree
+fact_tree_err_t fact_tree_attrs_build(fact_tree_attrs_t* attrs, const fact_tree_soa_t* soa, size_t names_size)
+{
+    utils_assert(attrs);
+    utils_assert(soa);
+
+    memset(attrs, 0, sizeof(*attrs));
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    uint32_t* first = TYPED_CALLOC(soa->size, uint32_t);
+    uint32_t* last  = TYPED_CALLOC(soa->size, uint32_t);
+
+    attrs->offsets    = TYPED_CALLOC(names_size + 1, uint32_t);
+    attrs->names_size = names_size;
+
+    BEGIN {
+        if((soa->size && (!first || !last)) || !attrs->offsets) {
+            err = FACT_TREE_ALLOC_FAIL;
+            GOTO_END;
+        }
+
+        // questions are counted by name in the slot after the name
+        for(size_t i = 0; i < soa->size; ++i) {
+            first[i] = (uint32_t) attrs->leaves_size;
+
+            if(fact_tree_attrs_is_leaf_(&soa->links[i])) {
+                ++attrs->leaves_size;
+            }
+            else {
+                utils_assert(soa->name_ids[i] < names_size);
+                ++attrs->offsets[soa->name_ids[i] + 1];
+                ++attrs->questions_size;
+            }
+        }
+
+        for(size_t i = soa->size; i-- > 0; ) {
+            const fact_tree_soa_link_t* link = &soa->links[i];
+
+            if(fact_tree_attrs_is_leaf_(link))
+                last[i] = first[i] + 1;
+            else
+                last[i] = last[link->right != FACT_TREE_SOA_NIL ? link->right : link->left];
+        }
+
+        attrs->leaves    = TYPED_CALLOC(attrs->leaves_size, fact_tree_node_t*);
+        attrs->questions = TYPED_CALLOC(attrs->questions_size, fact_tree_attrs_question_t);
+
+        if((attrs->leaves_size && !attrs->leaves) || (attrs->questions_size && !attrs->questions)) {
+            err = FACT_TREE_ALLOC_FAIL;
+            GOTO_END;
+        }
+
+        for(size_t id = 0; id < names_size; ++id)
+            attrs->offsets[id + 1] += attrs->offsets[id];
+
+        // offsets[id] is moved to the end of the questions of id as
+        // they are entered, which is where those of id + 1 start
+        for(size_t i = 0; i < soa->size; ++i) {
+            const fact_tree_soa_link_t* link = &soa->links[i];
+
+            if(fact_tree_attrs_is_leaf_(link)) {
+                attrs->leaves[first[i]] = soa->nodes[i];
+                continue;
+            }
+
+            attrs->questions[attrs->offsets[soa->name_ids[i]]++] = {
+                .no  = fact_tree_attrs_range_(first, last, link->left),
+                .yes = fact_tree_attrs_range_(first, last, link->right)
+            };
+        }
+
+        memmove(attrs->offsets + 1, attrs->offsets, names_size * sizeof(attrs->offsets[0]));
+        attrs->offsets[0] = 0;
+
+        memstat_alloc(MEMSTAT_INDEX, fact_tree_attrs_bytes_(attrs));
+
+    } END;
+
+    NFREE(first);
+    NFREE(last);
+
+    if(err != FACT_TREE_ERR_NONE) {
+        NFREE(attrs->leaves);
+        NFREE(attrs->offsets);
+        NFREE(attrs->questions);
+        memset(attrs, 0, sizeof(*attrs));
+    }
+
+    return err;
+}
+
+void fact_tree_attrs_dtor(fact_tree_attrs_t* attrs)
+{
+    utils_assert(attrs);
+
+    if(attrs->offsets)
+        memstat_free(MEMSTAT_INDEX, fact_tree_attrs_bytes_(attrs));
+
+    NFREE(attrs->leaves);
+    NFREE(attrs->offsets);
+    NFREE(attrs->questions);
+
+    memset(attrs, 0, sizeof(*attrs));
+}
+
+static int fact_tree_query_reserve_(fact_tree_attrs_range_t** ranges, size_t* capacity, size_t size)
+{
+    if(size <= *capacity)
+        return 1;
+
+    size_t capacity_new = *capacity ? *capacity * 2 : QUERY_INIT_CAPACITY_;
+    while(capacity_new < size)
+        capacity_new *= 2;
+
+    fact_tree_attrs_range_t* ranges_new = (fact_tree_attrs_range_t*) realloc(*ranges, capacity_new * sizeof(ranges_new[0]));
+    ranges_new verified(return 0);
+
+    memstat_resize(MEMSTAT_INDEX, *capacity * sizeof(ranges_new[0]), capacity_new * sizeof(ranges_new[0]));
+
+    *ranges   = ranges_new;
+    *capacity = capacity_new;
+
+    return 1;
+}
+
+static void fact_tree_query_rewind_(fact_tree_query_t* query)
+{
+    query->range = 0;
+    query->leaf  = query->size ? query->ranges[0].first : 0;
+}
+
+fact_tree_err_t fact_tree_query_start(fact_tree_query_t* query, const fact_tree_attrs_t* attrs)
+{
+    utils_assert(query);
+    utils_assert(attrs);
+
+    memset(query, 0, sizeof(*query));
+    query->attrs = attrs;
+
+    if(attrs->leaves_size) {
+        fact_tree_query_reserve_(&query->ranges, &query->capacity, 1) verified(return FACT_TREE_ALLOC_FAIL);
+
+        query->ranges[query->size++] = { .first = 0, .last = (uint32_t) attrs->leaves_size };
+    }
+
+    fact_tree_query_rewind_(query);
+
+    return FACT_TREE_ERR_NONE;
+}
+
+static int fact_tree_query_range_cmp_(const void* a, const void* b)
+{
+    uint32_t first_a = ((const fact_tree_attrs_range_t*) a)->first;
+    uint32_t first_b = ((const fact_tree_attrs_range_t*) b)->first;
+
+    return (first_a > first_b) - (first_a < first_b);
+}
+
+// The ranges of all questions with the name, sorted and merged.
+// A question asked again inside its own subtree gives nested ranges
+static size_t fact_tree_query_collect_(fact_tree_query_t* query, uint32_t name_id, int yes)
+{
+    const fact_tree_attrs_t* attrs = query->attrs;
+
+    if(name_id >= attrs->names_size)
+        return 0;
+
+    fact_tree_attrs_range_t* found = query->found;
+    size_t size = 0;
+
+    for(uint32_t i = attrs->offsets[name_id]; i < attrs->offsets[name_id + 1]; ++i) {
+        fact_tree_attrs_range_t range = yes ? attrs->questions[i].yes : attrs->questions[i].no;
+
+        if(range.first < range.last)
+            found[size++] = range;
+    }
+
+    if(size)
+        qsort(found, size, sizeof(found[0]), fact_tree_query_range_cmp_);
+
+    size_t merged = 0;
+
+    for(size_t i = 0; i < size; ++i) {
+        if(merged && found[i].first <= found[merged - 1].last) {
+            if(found[i].last > found[merged - 1].last)
+                found[merged - 1].last = found[i].last;
+        }
+        else {
+            found[merged++] = found[i];
+        }
+    }
+
+    return merged;
+}
+
+fact_tree_err_t fact_tree_query_and(fact_tree_query_t* query, uint32_t name_id, int yes)
+{
+    utils_assert(query);
+    utils_assert(query->attrs);
+
+    const fact_tree_attrs_t* attrs = query->attrs;
+
+    size_t questions = name_id < attrs->names_size ? attrs->offsets[name_id + 1] - attrs->offsets[name_id] : 0;
+
+    fact_tree_query_reserve_(&query->found, &query->found_capacity, questions) verified(return FACT_TREE_ALLOC_FAIL);
+
+    size_t found_size = fact_tree_query_collect_(query, name_id, yes);
+
+    fact_tree_query_reserve_(&query->next, &query->next_capacity, query->size + found_size) verified(return FACT_TREE_ALLOC_FAIL);
+
+    const fact_tree_attrs_range_t* ranges = query->ranges;
+    const fact_tree_attrs_range_t* found  = query->found;
+
+    size_t i = 0, j = 0, size = 0;
+
+    // both lists are sorted and disjoint, the one
+    // ending first cannot meet anything further on
+    while(i < query->size && j < found_size) {
+        uint32_t first = ranges[i].first > found[j].first ? ranges[i].first : found[j].first;
+        uint32_t last  = ranges[i].last  < found[j].last  ? ranges[i].last  : found[j].last;
+
+        if(first < last)
+            query->next[size++] = { .first = first, .last = last };
+
+        if(ranges[i].last < found[j].last)
+            ++i;
+        else
+            ++j;
+    }
+
+    utils_swap(&query->ranges,   &query->next,          sizeof(query->ranges));
+    utils_swap(&query->capacity, &query->next_capacity, sizeof(query->capacity));
+    query->size = size;
+
+    fact_tree_query_rewind_(query);
+
+    return FACT_TREE_ERR_NONE;
+}
+
+const fact_tree_node_t* fact_tree_query_next(fact_tree_query_t* query)
+{
+    utils_assert(query);
+
+    while(query->range < query->size) {
+        if(query->leaf < query->ranges[query->range].last)
+            return query->attrs->leaves[query->leaf++];
+
+        if(++query->range < query->size)
+            query->leaf = query->ranges[query->range].first;
+    }
+
+    return NULL;
+}
+
+size_t fact_tree_query_count(const fact_tree_query_t* query)
+{
+    utils_assert(query);
+
+    size_t count = 0;
+
+    for(size_t i = 0; i < query->size; ++i)
+        count += query->ranges[i].last - query->ranges[i].first;
+
+    return count;
+}
+
+void fact_tree_query_end(fact_tree_query_t* query)
+{
+    utils_assert(query);
+
+    size_t capacity = query->capacity + query->found_capacity + query->next_capacity;
+
+    if(capacity)
+        memstat_free(MEMSTAT_INDEX, capacity * sizeof(query->ranges[0]));
+
+    NFREE(query->ranges);
+    NFREE(query->found);
+    NFREE(query->next);
+
+    memset(query, 0, sizeof(*query));
+}
+
+#undef QUERY_INIT_CAPACITY_
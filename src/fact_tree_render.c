@@ -0,0 +1,177 @@
+#include "fact_tree_render.h"
+
+#include <string.h>
+
+#include "assertutils.h"
+
+#define NO_PREFIX_  " not "
+#define YES_PREFIX_ " "
+#define SEPARATOR_  ","
+
+#define LITERAL_LEN_(literal) (sizeof(literal) - 1)
+
+// Text of known length written into a buffer that may be too short
+typedef struct fact_tree_render_text_t
+{
+    char* buf;
+    size_t size;
+    size_t len;
+} fact_tree_render_text_t;
+
+// Copies the part of str that lands before the last byte of
+// the buffer, the last byte is kept for the terminator
+static void fact_tree_render_at_(fact_tree_render_text_t* text, size_t pos, const char* str, size_t len)
+{
+    size_t room = text->size ? text->size - 1 : 0;
+
+    if(pos >= room)
+        return;
+
+    if(len > room - pos)
+        len = room - pos;
+
+    memcpy(text->buf + pos, str, len);
+}
+
+static void fact_tree_render_put_(fact_tree_render_text_t* text, const char* str, size_t len)
+{
+    fact_tree_render_at_(text, text->len, str, len);
+    text->len += len;
+}
+
+static void fact_tree_render_put_name_(fact_tree_render_text_t* text, const fact_tree_node_t* node)
+{
+    fact_tree_render_put_(text, fact_tree_node_name(node), node->name_len);
+}
+
+static size_t fact_tree_render_finish_(fact_tree_render_text_t* text)
+{
+    if(text->size)
+        text->buf[text->len < text->size ? text->len : text->size - 1] = '\0';
+
+    return text->len;
+}
+
+// The answer that leads from the parent of node to node
+static size_t fact_tree_render_clause_len_(const fact_tree_node_t* node)
+{
+    size_t prefix = node == node->parent->left ? LITERAL_LEN_(NO_PREFIX_) : LITERAL_LEN_(YES_PREFIX_);
+
+    return prefix + node->parent->name_len;
+}
+
+static size_t fact_tree_render_path_len_(const fact_tree_node_t* node, const fact_tree_node_t* top)
+{
+    size_t len = 0;
+
+    for( ; node != top && node->parent; node = node->parent)
+        len += fact_tree_render_clause_len_(node) + LITERAL_LEN_(SEPARATOR_);
+
+    return len ? len - LITERAL_LEN_(SEPARATOR_) : 0;
+}
+
+// Parents are all a node knows of its path, so the answers are
+// written from the last one up: the length of the path is
+// measured first and its text is filled in back to front
+static void fact_tree_render_path_(fact_tree_render_text_t* text, const fact_tree_node_t* node, const fact_tree_node_t* top)
+{
+    size_t end = text->len + fact_tree_render_path_len_(node, top);
+
+    text->len = end;
+
+    for(int last = 1; node != top && node->parent; node = node->parent, last = 0) {
+        const fact_tree_node_t* question = node->parent;
+
+        if(!last) {
+            end -= LITERAL_LEN_(SEPARATOR_);
+            fact_tree_render_at_(text, end, SEPARATOR_, LITERAL_LEN_(SEPARATOR_));
+        }
+
+        end -= question->name_len;
+        fact_tree_render_at_(text, end, fact_tree_node_name(question), question->name_len);
+
+        if(node == question->left) {
+            end -= LITERAL_LEN_(NO_PREFIX_);
+            fact_tree_render_at_(text, end, NO_PREFIX_, LITERAL_LEN_(NO_PREFIX_));
+        }
+        else {
+            end -= LITERAL_LEN_(YES_PREFIX_);
+            fact_tree_render_at_(text, end, YES_PREFIX_, LITERAL_LEN_(YES_PREFIX_));
+        }
+    }
+}
+
+size_t fact_tree_clauses(const fact_tree_node_t* node, const fact_tree_node_t* top, fact_tree_clause_t* clauses, size_t max)
+{
+    utils_assert(node);
+    utils_assert(clauses || !max);
+
+    size_t count = 0;
+    for(const fact_tree_node_t* cur = node; cur != top && cur->parent; cur = cur->parent)
+        ++count;
+
+    // the deepest answer goes last
+    size_t i = count;
+    for(const fact_tree_node_t* cur = node; cur != top && cur->parent; cur = cur->parent) {
+        if(--i < max) {
+            clauses[i] = {
+                .question = cur->parent,
+                .yes      = cur == cur->parent->right
+            };
+        }
+    }
+
+    return count;
+}
+
+size_t fact_tree_render_definition(const fact_tree_node_t* node, char* buf, size_t size)
+{
+    utils_assert(node);
+    utils_assert(buf || !size);
+
+    fact_tree_render_text_t text = { .buf = buf, .size = size, .len = 0 };
+
+    fact_tree_render_put_name_(&text, node);
+    fact_tree_render_path_(&text, node, NULL);
+
+    return fact_tree_render_finish_(&text);
+}
+
+#define PUT_LITERAL_(text, literal) \
+    fact_tree_render_put_(text, literal, LITERAL_LEN_(literal))
+
+size_t fact_tree_render_difference(const fact_tree_node_t* node_a, const fact_tree_node_t* node_b, char* buf, size_t size)
+{
+    utils_assert(node_a);
+    utils_assert(node_b);
+    utils_assert(buf || !size);
+
+    const fact_tree_node_t* split = fact_tree_common_ancestor(node_a, node_b);
+    utils_assert(split);
+
+    fact_tree_render_text_t text = { .buf = buf, .size = size, .len = 0 };
+
+    fact_tree_render_put_name_(&text, node_a);
+    PUT_LITERAL_(&text, " and ");
+    fact_tree_render_put_name_(&text, node_b);
+    PUT_LITERAL_(&text, " both:");
+    fact_tree_render_path_(&text, split, NULL);
+
+    PUT_LITERAL_(&text, ", but ");
+    fact_tree_render_put_name_(&text, node_a);
+    fact_tree_render_path_(&text, node_a, split);
+
+    PUT_LITERAL_(&text, ", and ");
+    fact_tree_render_put_name_(&text, node_b);
+    fact_tree_render_path_(&text, node_b, split);
+
+    PUT_LITERAL_(&text, ".");
+
+    return fact_tree_render_finish_(&text);
+}
+
+#undef PUT_LITERAL_
+#undef LITERAL_LEN_
+#undef NO_PREFIX_
+#undef YES_PREFIX_
+#undef SEPARATOR_
@@ -0,0 +1,138 @@
+#include "fact_tree_soa.h"
+
+#include <string.h>
+
+#include "memutils.h"
+#include "assertutils.h"
+
+#define SOA_STACK_INIT_CAPACITY_ 64
+
+typedef struct fact_tree_soa_frame_t
+{
+    fact_tree_node_t* node;
+    uint32_t parent;
+    int is_right;
+} fact_tree_soa_frame_t;
+
+static fact_tree_err_t fact_tree_soa_reserve_(fact_tree_soa_t* soa, size_t* capacity)
+{
+    if(soa->size < *capacity)
+        return FACT_TREE_ERR_NONE;
+
+    size_t capacity_new = *capacity ? *capacity * 2 : SOA_STACK_INIT_CAPACITY_;
+
+    fact_tree_soa_link_t* links = (fact_tree_soa_link_t*) realloc(soa->links, capacity_new * sizeof(links[0]));
+    links verified(return FACT_TREE_ALLOC_FAIL);
+    soa->links = links;
+
+    uint32_t* name_ids = (uint32_t*) realloc(soa->name_ids, capacity_new * sizeof(name_ids[0]));
+    name_ids verified(return FACT_TREE_ALLOC_FAIL);
+    soa->name_ids = name_ids;
+
+    fact_tree_node_t** nodes = (fact_tree_node_t**) realloc(soa->nodes, capacity_new * sizeof(nodes[0]));
+    nodes verified(return FACT_TREE_ALLOC_FAIL);
+    soa->nodes = nodes;
+
+    *capacity = capacity_new;
+
+    return FACT_TREE_ERR_NONE;
+}
+
+fact_tree_err_t fact_tree_soa_build(fact_tree_t* ftree, fact_tree_soa_t* soa)
+{
+    utils_assert(ftree);
+    utils_assert(soa);
+
+    memset(soa, 0, sizeof(*soa));
+
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    // the node count is known up front, growing is only a safety net
+    size_t capacity = 0;
+    if(ftree->size) {
+        soa->links    = TYPED_CALLOC(ftree->size, fact_tree_soa_link_t);
+        soa->name_ids = TYPED_CALLOC(ftree->size, uint32_t);
+        soa->nodes    = TYPED_CALLOC(ftree->size, fact_tree_node_t*);
+        capacity      = ftree->size;
+
+        if(!soa->links || !soa->name_ids || !soa->nodes) {
+            fact_tree_soa_dtor(soa);
+            return FACT_TREE_ALLOC_FAIL;
+        }
+    }
+
+    fact_tree_soa_frame_t* frames = NULL;
+    size_t frames_size = 0, frames_capacity = 0;
+
+    fact_tree_soa_frame_t next = { .node = ftree->root, .parent = FACT_TREE_SOA_NIL, .is_right = 0 };
+
+    while(next.node) {
+        err = fact_tree_soa_reserve_(soa, &capacity);
+        if(err != FACT_TREE_ERR_NONE)
+            break;
+
+        fact_tree_node_t* node = next.node;
+
+        if(fact_tree_node_name_id(ftree, node) == STR_POOL_NONE) {
+            err = FACT_TREE_ALLOC_FAIL;
+            break;
+        }
+
+        uint32_t id = (uint32_t) soa->size++;
+
+        soa->links[id]    = { .left = FACT_TREE_SOA_NIL, .right = FACT_TREE_SOA_NIL, .parent = next.parent };
+        soa->name_ids[id] = node->name_id;
+        soa->nodes[id]    = node;
+
+        if(next.parent != FACT_TREE_SOA_NIL) {
+            if(next.is_right)
+                soa->links[next.parent].right = id;
+            else
+                soa->links[next.parent].left  = id;
+        }
+
+        fact_tree_node_t* left  = fact_tree_node_left(ftree, node);
+        fact_tree_node_t* right = fact_tree_node_right(ftree, node);
+
+        // the right child waits on the stack while the left subtree is numbered
+        if(right) {
+            if(frames_size == frames_capacity) {
+                frames_capacity = frames_capacity ? frames_capacity * 2 : SOA_STACK_INIT_CAPACITY_;
+                fact_tree_soa_frame_t* frames_new =
+                    (fact_tree_soa_frame_t*) realloc(frames, frames_capacity * sizeof(frames[0]));
+                if(!frames_new) {
+                    err = FACT_TREE_ALLOC_FAIL;
+                    break;
+                }
+                frames = frames_new;
+            }
+
+            frames[frames_size++] = { .node = right, .parent = id, .is_right = 1 };
+        }
+
+        if(left)
+            next = { .node = left, .parent = id, .is_right = 0 };
+        else if(frames_size)
+            next = frames[--frames_size];
+        else
+            next.node = NULL;
+    }
+
+    NFREE(frames);
+
+    if(err != FACT_TREE_ERR_NONE)
+        fact_tree_soa_dtor(soa);
+
+    return err;
+}
+
+void fact_tree_soa_dtor(fact_tree_soa_t* soa)
+{
+    NFREE(soa->links);
+    NFREE(soa->name_ids);
+    NFREE(soa->nodes);
+
+    soa->size = 0;
+}
+
+#undef SOA_STACK_INIT_CAPACITY_
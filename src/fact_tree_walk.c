@@ -0,0 +1,176 @@
+#include "fact_tree_walk.h"
+
+#include "assertutils.h"
+
+// Sets err and empties the walk if the frames cannot grow
+static void fact_tree_walk_push_(fact_tree_walk_t* walk, fact_tree_node_t* node, size_t depth)
+{
+    fact_tree_walk_frame_t frame = {
+        .node  = node,
+        .depth = depth,
+        .stage = FACT_TREE_WALK_STAGE_ENTER
+    };
+
+    if(stack_push(&walk->frames, frame) != STACK_ERR_NONE) {
+        walk->err         = FACT_TREE_ALLOC_FAIL;
+        walk->frames.size = 0;
+    }
+}
+
+static int fact_tree_walk_emit_(fact_tree_walk_t* walk, fact_tree_node_t* node, size_t depth, fact_tree_walk_event_t event)
+{
+    walk->node  = node;
+    walk->depth = depth;
+    walk->event = event;
+
+    return 1;
+}
+
+void fact_tree_walk_begin(fact_tree_walk_t* walk, fact_tree_t* ftree, fact_tree_node_t* root, unsigned flags)
+{
+    utils_assert(walk);
+    utils_assert(ftree || (flags & FACT_TREE_WALK_BUILT));
+
+    walk->ftree    = ftree;
+    walk->flags    = flags;
+    walk->node     = NULL;
+    walk->depth    = 0;
+    walk->event    = FACT_TREE_WALK_PRE;
+    walk->err      = FACT_TREE_ERR_NONE;
+    walk->pushed   = 0;
+
+    stack_ctor(&walk->frames);
+
+    if(root)
+        fact_tree_walk_push_(walk, root, 0);
+}
+
+// The left child is pushed together with the pre-order event, the
+// right one together with the in-order event, so that a node takes
+// three steps: enter, between the children and exit
+static int fact_tree_walk_next_staged_(fact_tree_walk_t* walk)
+{
+    while(walk->frames.size) {
+        fact_tree_walk_frame_t* top = &walk->frames.buffer[walk->frames.size - 1];
+
+        fact_tree_node_t* node  = top->node;
+        size_t            depth = top->depth;
+        fact_tree_node_t* child = NULL;
+
+        switch(top->stage) {
+            case FACT_TREE_WALK_STAGE_ENTER:
+                top->stage = FACT_TREE_WALK_STAGE_MID;
+
+                // the right subtree is reached right after the left one
+                __builtin_prefetch(node->right);
+
+                child = fact_tree_walk_child(walk, node, 0);
+
+                walk->pushed = 0;
+
+                if(walk->err != FACT_TREE_ERR_NONE)
+                    return 0;
+
+                if(!child && !node->right && (walk->flags & FACT_TREE_WALK_LEAF)) {
+                    --walk->frames.size;
+                    return fact_tree_walk_emit_(walk, node, depth, FACT_TREE_WALK_LEAF);
+                }
+
+                if(child) {
+                    fact_tree_walk_push_(walk, child, depth + 1);
+                    ++walk->pushed;
+                }
+
+                if(walk->flags & FACT_TREE_WALK_PRE)
+                    return fact_tree_walk_emit_(walk, node, depth, FACT_TREE_WALK_PRE);
+                break;
+
+            case FACT_TREE_WALK_STAGE_MID:
+                top->stage = FACT_TREE_WALK_STAGE_EXIT;
+
+                child = fact_tree_walk_child(walk, node, 1);
+
+                if(walk->err != FACT_TREE_ERR_NONE)
+                    return 0;
+
+                if(child)
+                    fact_tree_walk_push_(walk, child, depth + 1);
+
+                if(walk->flags & FACT_TREE_WALK_IN)
+                    return fact_tree_walk_emit_(walk, node, depth, FACT_TREE_WALK_IN);
+                break;
+
+            case FACT_TREE_WALK_STAGE_EXIT:
+            default:
+                --walk->frames.size;
+
+                if(walk->flags & FACT_TREE_WALK_POST)
+                    return fact_tree_walk_emit_(walk, node, depth, FACT_TREE_WALK_POST);
+                break;
+        }
+    }
+
+    return 0;
+}
+
+// Walks asking for pre-order and leaf events only keep no stages:
+// the stack holds nodes yet to be visited. The children of a node
+// are pushed as it is reached, the left one on top
+static int fact_tree_walk_next_pre_(fact_tree_walk_t* walk)
+{
+    while(walk->frames.size) {
+        fact_tree_walk_frame_t top = {};
+        stack_pop(&walk->frames, &top);
+
+        // expands both children at once
+        fact_tree_walk_child(walk, top.node, 0);
+
+        if(walk->err != FACT_TREE_ERR_NONE)
+            return 0;
+
+        fact_tree_node_t* right = top.node->right;
+        fact_tree_node_t* left  = top.node->left;
+
+        walk->pushed = 0;
+
+        if(!right && !left && (walk->flags & FACT_TREE_WALK_LEAF))
+            return fact_tree_walk_emit_(walk, top.node, top.depth, FACT_TREE_WALK_LEAF);
+
+        size_t size = walk->frames.size;
+
+        if(right)
+            fact_tree_walk_push_(walk, right, top.depth + 1);
+
+        if(left)
+            fact_tree_walk_push_(walk, left, top.depth + 1);
+
+        if(walk->err != FACT_TREE_ERR_NONE)
+            return 0;
+
+        walk->pushed = walk->frames.size - size;
+
+        if(walk->flags & FACT_TREE_WALK_PRE)
+            return fact_tree_walk_emit_(walk, top.node, top.depth, FACT_TREE_WALK_PRE);
+    }
+
+    return 0;
+}
+
+int fact_tree_walk_next(fact_tree_walk_t* walk)
+{
+    utils_assert(walk);
+
+    if((walk->flags & (FACT_TREE_WALK_IN | FACT_TREE_WALK_POST)) == 0)
+        return fact_tree_walk_next_pre_(walk);
+
+    return fact_tree_walk_next_staged_(walk);
+}
+
+fact_tree_err_t fact_tree_walk_end(fact_tree_walk_t* walk)
+{
+    utils_assert(walk);
+
+    stack_dtor(&walk->frames);
+
+    return walk->err;
+}
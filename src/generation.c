@@ -0,0 +1,124 @@
+#include "generation.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define NEW_FILE_MODE_ 0644
+
+generation_err_t generation_open(generation_t* gen, const char* path)
+{
+    memset(gen, 0, sizeof(*gen));
+
+    gen->writable = 1;
+
+    gen->fd = open(path, O_RDWR | O_CREAT, NEW_FILE_MODE_);
+    if(gen->fd < 0 && (errno == EACCES || errno == EROFS)) {
+        gen->writable = 0;
+        gen->fd = open(path, O_RDONLY);
+    }
+
+    if(gen->fd < 0)
+        return GENERATION_IO_ERR;
+
+    generation_err_t err = GENERATION_ERR_NONE;
+
+    struct stat fstats = {};
+    if(fstat(gen->fd, &fstats) < 0)
+        err = GENERATION_IO_ERR;
+
+    // growing a file is a no-op for everyone but its creator,
+    // a reader cannot grow it and must not map past its end
+    if(err == GENERATION_ERR_NONE && fstats.st_size < (off_t) sizeof(generation_header_t)) {
+        if(!gen->writable)
+            err = GENERATION_FORMAT_ERR;
+        else if(ftruncate(gen->fd, (off_t) sizeof(generation_header_t)) != 0)
+            err = GENERATION_IO_ERR;
+    }
+
+    if(err == GENERATION_ERR_NONE) {
+        void* map = mmap(
+            NULL, 
+            sizeof(generation_header_t), 
+            gen->writable ? PROT_READ | PROT_WRITE : PROT_READ, 
+            MAP_SHARED, 
+            gen->fd, 
+            0
+        );
+
+        if(map == MAP_FAILED)
+            err = GENERATION_IO_ERR;
+        else
+            gen->header = (generation_header_t*) map;
+    }
+
+    // a new file is all zeroes: generation 0 without a magic yet
+    if(err == GENERATION_ERR_NONE) {
+        static const char zeroes[sizeof(gen->header->magic)] = {};
+
+        if(memcmp(gen->header->magic, zeroes, sizeof(zeroes)) == 0) {
+            if(gen->writable)
+                memcpy(gen->header->magic, GENERATION_MAGIC, sizeof(gen->header->magic));
+        }
+        else if(memcmp(gen->header->magic, GENERATION_MAGIC, sizeof(gen->header->magic)) != 0) {
+            err = GENERATION_FORMAT_ERR;
+        }
+    }
+
+    if(err != GENERATION_ERR_NONE)
+        generation_close(gen);
+
+    return err;
+}
+
+uint64_t generation_get(const generation_t* gen)
+{
+    return __atomic_load_n(&gen->header->value, __ATOMIC_ACQUIRE);
+}
+
+generation_err_t generation_bump(generation_t* gen, uint64_t* value)
+{
+    if(!gen->writable)
+        return GENERATION_READ_ONLY;
+
+    *value = __atomic_add_fetch(&gen->header->value, 1, __ATOMIC_RELEASE);
+
+    return GENERATION_ERR_NONE;
+}
+
+generation_err_t generation_close(generation_t* gen)
+{
+    generation_err_t err = GENERATION_ERR_NONE;
+
+    if(gen->header && munmap(gen->header, sizeof(generation_header_t)) != 0)
+        err = GENERATION_IO_ERR;
+
+    if(gen->fd >= 0 && close(gen->fd) != 0)
+        err = GENERATION_IO_ERR;
+
+    gen->header = NULL;
+    gen->fd     = -1;
+
+    return err;
+}
+
+const char* generation_strerr(generation_err_t err)
+{
+    switch(err) {
+        case GENERATION_ERR_NONE:
+            return "none";
+        case GENERATION_IO_ERR:
+            return "io error";
+        case GENERATION_FORMAT_ERR:
+            return "invalid control file";
+        case GENERATION_READ_ONLY:
+            return "control file is read-only";
+        default:
+            return "unknown";
+    }
+}
+
+#undef NEW_FILE_MODE_
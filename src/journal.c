@@ -0,0 +1,294 @@
+#include "journal.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define NEW_FILE_MODE_ 0644
+#define DJB2_INIT_ 5381u
+
+static uint32_t journal_djb2_(uint32_t hash, const void* data, size_t len)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+
+    for(size_t i = 0; i < len; ++i)
+        hash = hash * 33u + bytes[i];
+
+    return hash;
+}
+
+static uint64_t journal_path_bytes_(uint32_t depth)
+{
+    return ((uint64_t) depth + 7) / 8;
+}
+
+static journal_err_t journal_pwrite_all_(int fd, const char* data, size_t len, uint64_t offset)
+{
+    while(len) {
+        ssize_t written = pwrite(fd, data, len, (off_t) offset);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            return JOURNAL_IO_ERR;
+
+        data   += written;
+        len    -= (size_t) written;
+        offset += (size_t) written;
+    }
+
+    return JOURNAL_ERR_NONE;
+}
+
+// a new file survives a crash only once its directory entry is synced
+static journal_err_t journal_fsync_dir_(const char* path)
+{
+    char* path_copy = strdup(path);
+    if(!path_copy)
+        return JOURNAL_ALLOC_FAIL;
+
+    int dir_fd = open(dirname(path_copy), O_RDONLY | O_DIRECTORY);
+    free(path_copy);
+
+    if(dir_fd < 0)
+        return JOURNAL_IO_ERR;
+
+    int ok = fsync(dir_fd) == 0;
+    close(dir_fd);
+
+    return ok ? JOURNAL_ERR_NONE : JOURNAL_IO_ERR;
+}
+
+static int journal_header_matches_(const journal_header_t* header, const journal_base_t* base)
+{
+    return memcmp(header->magic, JOURNAL_MAGIC, sizeof(header->magic)) == 0
+        && header->version       == JOURNAL_VERSION
+        && header->base.size     == base->size
+        && header->base.mtime_ns == base->mtime_ns;
+}
+
+journal_err_t journal_open(journal_t* journal, const char* path, const journal_base_t* base)
+{
+    memset(journal, 0, sizeof(*journal));
+
+    int created = 1;
+
+    journal->fd = open(path, O_RDWR | O_CREAT | O_EXCL, NEW_FILE_MODE_);
+    if(journal->fd < 0 && errno == EEXIST) {
+        created = 0;
+        journal->fd = open(path, O_RDWR);
+    }
+
+    if(journal->fd < 0)
+        return JOURNAL_IO_ERR;
+
+    journal_err_t err = JOURNAL_ERR_NONE;
+
+    if(created) {
+        err = journal_fsync_dir_(path);
+        if(err != JOURNAL_ERR_NONE) {
+            close(journal->fd);
+            journal->fd = -1;
+            return err;
+        }
+    }
+
+    struct stat fstats = {};
+    if(fstat(journal->fd, &fstats) < 0) {
+        close(journal->fd);
+        journal->fd = -1;
+        return JOURNAL_IO_ERR;
+    }
+
+    journal_header_t header = {};
+
+    if(fstats.st_size >= (off_t) sizeof(header)
+            && pread(journal->fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header)
+            && journal_header_matches_(&header, base)) {
+        journal->size = (uint64_t) fstats.st_size;
+        return JOURNAL_ERR_NONE;
+    }
+
+    err = journal_reset(journal, base);
+    if(err != JOURNAL_ERR_NONE) {
+        close(journal->fd);
+        journal->fd = -1;
+        return err;
+    }
+
+    journal->dropped = (uint64_t) fstats.st_size;
+
+    return JOURNAL_ERR_NONE;
+}
+
+journal_err_t journal_replay(journal_t* journal, journal_apply_t apply, void* ctx)
+{
+    uint64_t len = journal->size - sizeof(journal_header_t);
+    if(!len)
+        return JOURNAL_ERR_NONE;
+
+    char* data = (char*) malloc(len);
+    if(!data)
+        return JOURNAL_ALLOC_FAIL;
+
+    if(pread(journal->fd, data, len, sizeof(journal_header_t)) != (ssize_t) len) {
+        free(data);
+        return JOURNAL_IO_ERR;
+    }
+
+    journal_err_t err = JOURNAL_ERR_NONE;
+    uint64_t off = 0;
+
+    while(off + sizeof(journal_record_t) <= len) {
+        journal_record_t rec = {};
+        memcpy(&rec, data + off, sizeof(rec));
+
+        uint64_t path_len = journal_path_bytes_(rec.depth);
+        uint64_t body_len = path_len + rec.name_len + rec.question_len;
+
+        if(body_len > len - off - sizeof(rec))
+            break;
+
+        const char* body = data + off + sizeof(rec);
+
+        uint32_t checksum = journal_djb2_(DJB2_INIT_, data + off + sizeof(rec.checksum), sizeof(rec) - sizeof(rec.checksum));
+        checksum = journal_djb2_(checksum, body, body_len);
+
+        if(checksum != rec.checksum)
+            break;
+
+        journal_entry_t entry = {
+            .path         = (const uint8_t*) body,
+            .depth        = rec.depth,
+            .name         = body + path_len,
+            .name_len     = rec.name_len,
+            .question     = body + path_len + rec.name_len,
+            .question_len = rec.question_len
+        };
+
+        if(apply(ctx, &entry) != 0) {
+            err = JOURNAL_APPLY_FAIL;
+            break;
+        }
+
+        off += sizeof(rec) + body_len;
+        journal->records++;
+    }
+
+    free(data);
+
+    if(err == JOURNAL_ERR_NONE && off < len) {
+        journal->dropped = len - off;
+        journal->size    = sizeof(journal_header_t) + off;
+
+        if(ftruncate(journal->fd, (off_t) journal->size) != 0 || fsync(journal->fd) != 0)
+            err = JOURNAL_IO_ERR;
+    }
+
+    return err;
+}
+
+journal_err_t journal_append(journal_t* journal, const journal_entry_t* entry)
+{
+    uint64_t path_len = journal_path_bytes_(entry->depth);
+    uint64_t total    = sizeof(journal_record_t) + path_len + entry->name_len + entry->question_len;
+
+    char* data = (char*) malloc(total);
+    if(!data)
+        return JOURNAL_ALLOC_FAIL;
+
+    journal_record_t rec = {
+        .checksum     = 0,
+        .depth        = entry->depth,
+        .name_len     = entry->name_len,
+        .question_len = entry->question_len
+    };
+
+    char* body = data + sizeof(rec);
+
+    memcpy(body,                             entry->path,     path_len);
+    memcpy(body + path_len,                  entry->name,     entry->name_len);
+    memcpy(body + path_len + entry->name_len, entry->question, entry->question_len);
+
+    rec.checksum = journal_djb2_(DJB2_INIT_, (const char*) &rec + sizeof(rec.checksum), sizeof(rec) - sizeof(rec.checksum));
+    rec.checksum = journal_djb2_(rec.checksum, body, total - sizeof(rec));
+
+    memcpy(data, &rec, sizeof(rec));
+
+    journal_err_t err = journal_pwrite_all_(journal->fd, data, total, journal->size);
+
+    free(data);
+
+    if(err == JOURNAL_ERR_NONE && fdatasync(journal->fd) != 0)
+        err = JOURNAL_IO_ERR;
+
+    // a partly written record would hide every later one from replay
+    if(err != JOURNAL_ERR_NONE) {
+        if(ftruncate(journal->fd, (off_t) journal->size) != 0)
+            return JOURNAL_IO_ERR;
+        return err;
+    }
+
+    journal->size += total;
+    journal->records++;
+
+    return JOURNAL_ERR_NONE;
+}
+
+journal_err_t journal_reset(journal_t* journal, const journal_base_t* base)
+{
+    journal_header_t header = {};
+
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.base    = *base;
+
+    if(ftruncate(journal->fd, 0) != 0)
+        return JOURNAL_IO_ERR;
+
+    journal_err_t err = journal_pwrite_all_(journal->fd, (const char*) &header, sizeof(header), 0);
+    if(err != JOURNAL_ERR_NONE)
+        return err;
+
+    if(fsync(journal->fd) != 0)
+        return JOURNAL_IO_ERR;
+
+    journal->size    = sizeof(header);
+    journal->records = 0;
+
+    return JOURNAL_ERR_NONE;
+}
+
+journal_err_t journal_close(journal_t* journal)
+{
+    journal_err_t err = JOURNAL_ERR_NONE;
+
+    if(journal->fd >= 0 && close(journal->fd) != 0)
+        err = JOURNAL_IO_ERR;
+
+    journal->fd = -1;
+
+    return err;
+}
+
+const char* journal_strerr(journal_err_t err)
+{
+    switch(err) {
+        case JOURNAL_ERR_NONE:
+            return "none";
+        case JOURNAL_IO_ERR:
+            return "io error";
+        case JOURNAL_ALLOC_FAIL:
+            return "memory allocation failed";
+        case JOURNAL_APPLY_FAIL:
+            return "record does not match the database";
+        default:
+            return "unknown";
+    }
+}
+
+#undef NEW_FILE_MODE_
+#undef DJB2_INIT_
@@ -1,7 +1,13 @@
+#include <string.h>
+#include <ctype.h>
+
 #include <festival/festival.h>
 #include <speech_tools/EST_String.h>
 
 #include "fact_tree.h"
+#include "fact_tree_embed.h"
+#include "fact_tree_query.h"
+#include "memstat.h"
 #include "optutils.h"
 #include "memutils.h"
 #include "utils.h"
@@ -11,10 +17,41 @@
 #define LOG_CATEGORY_OPT "OPTIONS"
 #define LOG_CATEGORY_APP "APP"
 
+// Festival's heap is counted in Lisp cells of two pointers and a type tag
+#define FESTIVAL_CELL_SIZE_ (2 * sizeof(void*) + sizeof(long))
+
+typedef enum app_opt_t
+{
+    APP_OPT_LOG,
+    APP_OPT_DB,
+    APP_OPT_TO_BIN,
+    APP_OPT_TO_TEXT,
+    APP_OPT_LAZY,
+    APP_OPT_TO_PAGES,
+    APP_OPT_POOL_SIZE,
+    APP_OPT_LAYOUT,
+    APP_OPT_SHARED,
+    APP_OPT_PUBLISH,
+    APP_OPT_TO_CPP,
+    APP_OPT_MEM_STATS,
+    APP_OPT_DEF_CACHE
+} app_opt_t;
+
 static utils_long_opt_t long_opts[] = 
 {
-    { OPT_ARG_REQUIRED, "log", NULL, 0, 0 },
-    { OPT_ARG_OPTIONAL, "db" , NULL, 0, 0 },
+    { OPT_ARG_REQUIRED, "log",     NULL, 0, 0 },
+    { OPT_ARG_OPTIONAL, "db" ,     NULL, 0, 0 },
+    { OPT_ARG_REQUIRED, "to-bin",  NULL, 0, 0 },
+    { OPT_ARG_REQUIRED, "to-text", NULL, 0, 0 },
+    { OPT_ARG_OPTIONAL, "lazy",      NULL, 0, 0 },
+    { OPT_ARG_REQUIRED, "to-pages",  NULL, 0, 0 },
+    { OPT_ARG_REQUIRED, "pool-size", NULL, 0, 0 },
+    { OPT_ARG_REQUIRED, "layout",    NULL, 0, 0 },
+    { OPT_ARG_OPTIONAL, "shared",    NULL, 0, 0 },
+    { OPT_ARG_REQUIRED, "publish",   NULL, 0, 0 },
+    { OPT_ARG_REQUIRED, "to-cpp",    NULL, 0, 0 },
+    { OPT_ARG_OPTIONAL, "mem-stats", NULL, 0, 0 },
+    { OPT_ARG_REQUIRED, "def-cache", NULL, 0, 0 },
 };
 
 typedef enum app_state_t 
@@ -25,6 +62,9 @@ typedef enum app_state_t
     APP_STATE_GUESS,
     APP_STATE_DEFINITION,
     APP_STATE_DIFFERENCE,
+    APP_STATE_COMPACT,
+    APP_STATE_MEMORY,
+    APP_STATE_QUERY,
     APP_STATE_EXIT
 } app_state_t;
 
@@ -33,6 +73,9 @@ typedef struct app_data_t
     app_state_t state;
     fact_tree_t* ftree;
     int exit;
+
+    // a newer shared database was not loaded over unsaved objects
+    int refresh_held;
 } app_data_t;
 
 typedef void (*app_callback_t) (app_data_t*);
@@ -49,6 +92,9 @@ void app_callback_save       (app_data_t* adata);
 void app_callback_guess      (app_data_t* adata);
 void app_callback_definition (app_data_t* adata);
 void app_callback_difference (app_data_t* adata);
+void app_callback_compact    (app_data_t* adata);
+void app_callback_memory     (app_data_t* adata);
+void app_callback_query      (app_data_t* adata);
 void app_callback_exit       (app_data_t* adata);
 
 static app_t app_state[] =
@@ -59,27 +105,33 @@ static app_t app_state[] =
     { APP_STATE_GUESS,      app_callback_guess      },
     { APP_STATE_DEFINITION, app_callback_definition },
     { APP_STATE_DIFFERENCE, app_callback_difference },
+    { APP_STATE_COMPACT,    app_callback_compact    },
+    { APP_STATE_MEMORY,     app_callback_memory     },
+    { APP_STATE_QUERY,      app_callback_query      },
     { APP_STATE_EXIT,       app_callback_exit       }
 };
 
 void clear_screen();
 
+int app_convert(fact_tree_t* ftree);
+
+fact_tree_err_t app_fread(fact_tree_t* ftree, const char* filename);
+
+size_t app_count_attrs(const char* str);
+
+const char* app_skip_spaces(const char* str, const char* end);
+
+size_t app_parse_attrs(const char* str, fact_tree_attr_t* attrs);
+
 int main(int argc, char* argv[])
 {
     utils_long_opt_get(argc, argv, long_opts, SIZEOF(long_opts));
 
-    if(!long_opts[0].is_set) {
+    if(!long_opts[APP_OPT_LOG].is_set) {
         return EXIT_FAILURE;
     }
 
-    utils_init_log_file(long_opts[0].arg, LOG_DIR);
-
-    // Festival documentation recommend use such default values
-    const int festival_load = 1;
-    const int festival_buffer = 2100000;
-    festival_initialize(festival_load, festival_buffer);
-
-    clear_screen();
+    utils_init_log_file(long_opts[APP_OPT_LOG].arg, LOG_DIR);
     // printf_and_say("Welcome to an EXYST expert system!\n");
     // printf_and_say("You will now be redirected to the main menu...\n");
 
@@ -91,19 +143,68 @@ int main(int argc, char* argv[])
         UTILS_LOGE(LOG_CATEGORY_APP, "%s", fact_tree_strerr(err));
     }
 
-    if(long_opts[1].is_set)
-        err = fact_tree_fread(&ftree, long_opts[1].arg);
+    // --layout=bfs|veb reorders nodes in memory after loads
+    // and is the order binary files are written in
+    if(long_opts[APP_OPT_LAYOUT].is_set) {
+        const char* layout = long_opts[APP_OPT_LAYOUT].arg;
+
+        if(strcmp(layout, "bfs") == 0)
+            ftree.layout = FACT_TREE_LAYOUT_BFS;
+        else if(strcmp(layout, "veb") == 0)
+            ftree.layout = FACT_TREE_LAYOUT_VEB;
+        else
+            UTILS_LOGE(LOG_CATEGORY_OPT, "unknown layout %s, expected bfs or veb", layout);
+    }
+
+    // --def-cache=<KiB> keeps rendered definitions of
+    // the objects asked about most recently
+    if(long_opts[APP_OPT_DEF_CACHE].is_set) {
+        size_t budget_kb = strtoul(long_opts[APP_OPT_DEF_CACHE].arg, NULL, 10);
+        def_cache_set_budget(&ftree.defs, budget_kb << 10);
+    }
+
+    // builds made with EMBED_DB start from the compiled-in database
+    if(long_opts[APP_OPT_DB].is_set)
+        err = app_fread(&ftree, long_opts[APP_OPT_DB].arg);
+    else if(fact_tree_has_embedded())
+        err = fact_tree_fread_embedded(&ftree);
     else
-        err = fact_tree_fread(&ftree, "db.txt");
+        err = app_fread(&ftree, "db.txt");
 
     if(err != FACT_TREE_ERR_NONE) {
         UTILS_LOGE(LOG_CATEGORY_APP, "%s", fact_tree_strerr(err));
     }
+
+    if(long_opts[APP_OPT_TO_BIN].is_set 
+            || long_opts[APP_OPT_TO_TEXT].is_set 
+            || long_opts[APP_OPT_TO_PAGES].is_set
+            || long_opts[APP_OPT_PUBLISH].is_set
+            || long_opts[APP_OPT_TO_CPP].is_set) {
+        int exit_code = err == FACT_TREE_ERR_NONE ? app_convert(&ftree) : EXIT_FAILURE;
+
+        if(long_opts[APP_OPT_MEM_STATS].is_set)
+            memstat_print(stdout);
+
+        fact_tree_dtor(&ftree);
+        utils_end_log();
+
+        return exit_code;
+    }
+
+    // Festival documentation recommend use such default values
+    const int festival_load = 1;
+    const int festival_buffer = 2100000;
+    festival_initialize(festival_load, festival_buffer);
+
+    memstat_alloc(MEMSTAT_FESTIVAL, festival_buffer * FESTIVAL_CELL_SIZE_);
+
+    clear_screen();
     
     app_data_t appdata = {
         .state = APP_STATE_MENU,
         .ftree = &ftree,
-        .exit = 0
+        .exit = 0,
+        .refresh_held = 0
     };
 
     while(!appdata.exit) {
@@ -117,6 +218,10 @@ int main(int argc, char* argv[])
         }
     }
 
+    // peaks stay, what is still held shows the live footprint
+    if(long_opts[APP_OPT_MEM_STATS].is_set)
+        memstat_print(stdout);
+
     fact_tree_dtor(&ftree);
 
     utils_end_log();
@@ -126,13 +231,19 @@ int main(int argc, char* argv[])
 
 void app_callback_menu(app_data_t* adata)
 {
+    if(adata->refresh_held)
+        printf("A newer database is published, save new objects to keep them\n\n");
+
     printf("Modes\n"
            "1. Guess\n"
            "2. Load from file\n"
            "3. Save to file\n"
            "4. Get defition\n"
            "5. Get difference\n"
-           "6. Exit\n"
+           "6. Compact database\n"
+           "7. Memory usage\n"
+           "8. Find objects by attributes\n"
+           "9. Exit\n"
            "Enter mode number: "
     );
 
@@ -140,6 +251,14 @@ void app_callback_menu(app_data_t* adata)
     scanf("%d", &input);
     clear_stdin_buffer();
     
+    // the menu may have waited long enough for
+    // a new version of a shared database to be published
+    fact_tree_err_t err = fact_tree_refresh(adata->ftree);
+    if(err != FACT_TREE_ERR_NONE && err != FACT_TREE_UNSAVED_ERR)
+        UTILS_LOGE(LOG_CATEGORY_APP, "%s", fact_tree_strerr(err));
+
+    adata->refresh_held = err == FACT_TREE_UNSAVED_ERR;
+
     switch(input) {
         case 1:
             adata->state = APP_STATE_GUESS;
@@ -157,6 +276,15 @@ void app_callback_menu(app_data_t* adata)
             adata->state = APP_STATE_DIFFERENCE;
             break;
         case 6:
+            adata->state = APP_STATE_COMPACT;
+            break;
+        case 7:
+            adata->state = APP_STATE_MEMORY;
+            break;
+        case 8:
+            adata->state = APP_STATE_QUERY;
+            break;
+        case 9:
             adata->state = APP_STATE_EXIT;
             break;
         default:
@@ -171,7 +299,7 @@ void app_callback_load(app_data_t* adata)
     utils_str_t str = { NULL, 0 };
     input_string_until_correct(&str.str, &str.len);
 
-    fact_tree_err_t err = fact_tree_fread(adata->ftree, str.str);
+    fact_tree_err_t err = app_fread(adata->ftree, str.str);
     if(err != FACT_TREE_ERR_NONE)
         UTILS_LOGE(LOG_CATEGORY_APP, "%s", fact_tree_strerr(err));
 
@@ -218,7 +346,7 @@ void app_callback_guess(app_data_t* adata)
 
         if(!node) GOTO_END;
 
-        printf("Is it %s? [" STR_ACCEPT "/" STR_DECLINE "]: ", node->name.str);
+        printf("Is it %.*s? [" STR_ACCEPT "/" STR_DECLINE "]: ", (int) node->name_len, fact_tree_node_name(node));
 
 
         char input = CHAR_DECLINE;
@@ -255,7 +383,7 @@ void app_callback_definition(app_data_t* adata)
     input_string_until_correct(&name.str, &name.len);
 
     const fact_tree_node_t* node 
-        = fact_tree_find_object(adata->ftree->root, name.str);
+        = fact_tree_find_object(adata->ftree, adata->ftree->root, name.str);
     
     BEGIN {
 
@@ -291,7 +419,7 @@ void app_callback_difference(app_data_t* adata)
         input_string_until_correct(&name_a.str, &name_a.len);
 
         const fact_tree_node_t* node_a
-            = fact_tree_find_object(adata->ftree->root, name_a.str);
+            = fact_tree_find_object(adata->ftree, adata->ftree->root, name_a.str);
 
         if(!node_a) {
             printf_and_say("No such object found!\n");
@@ -302,7 +430,7 @@ void app_callback_difference(app_data_t* adata)
         input_string_until_correct(&name_b.str, &name_b.len);
 
         const fact_tree_node_t* node_b
-            = fact_tree_find_object(adata->ftree->root, name_b.str);
+            = fact_tree_find_object(adata->ftree, adata->ftree->root, name_b.str);
 
         if(!node_b) {
             printf_and_say("No such object found!\n");
@@ -327,11 +455,199 @@ void app_callback_difference(app_data_t* adata)
     adata->state = APP_STATE_MENU;
 }
 
+void app_callback_compact(app_data_t* adata)
+{
+    fact_tree_err_t err = fact_tree_compact(adata->ftree);
+    if(err != FACT_TREE_ERR_NONE)
+        UTILS_LOGE(LOG_CATEGORY_APP, "%s", fact_tree_strerr(err));
+    else
+        printf_and_say("Database is up to date\n");
+
+    printf_and_say("Press any key to continue...");
+    scanf("%*c");
+
+    adata->state = APP_STATE_MENU;
+}
+
+void app_callback_memory(app_data_t* adata)
+{
+    memstat_print(stdout);
+
+    printf_and_say("Press any key to continue...");
+    scanf("%*c");
+
+    adata->state = APP_STATE_MENU;
+}
+
+#define ATTR_SEPARATOR ','
+#define ATTR_NEGATION "not "
+
+size_t app_count_attrs(const char* str)
+{
+    size_t count = 1;
+
+    for( ; *str; ++str)
+        if(*str == ATTR_SEPARATOR)
+            ++count;
+
+    return count;
+}
+
+const char* app_skip_spaces(const char* str, const char* end)
+{
+    while(str < end && isspace((unsigned char) *str))
+        ++str;
+
+    return str;
+}
+
+// Attributes are given the way definitions say them: "X, not Y"
+size_t app_parse_attrs(const char* str, fact_tree_attr_t* attrs)
+{
+    size_t size = 0;
+
+    while(*str) {
+        const char* end = strchr(str, ATTR_SEPARATOR);
+        if(!end)
+            end = str + strlen(str);
+
+        const char* question = app_skip_spaces(str, end);
+        const char* question_end = end;
+
+        while(question_end > question && isspace((unsigned char) question_end[-1]))
+            --question_end;
+
+        int yes = 1;
+        if((size_t)(question_end - question) > strlen(ATTR_NEGATION)
+                && strncmp(question, ATTR_NEGATION, strlen(ATTR_NEGATION)) == 0) {
+            question = app_skip_spaces(question + strlen(ATTR_NEGATION), question_end);
+            yes = 0;
+        }
+
+        if(question < question_end) {
+            attrs[size++] = {
+                .question = question,
+                .question_len = (size_t)(question_end - question),
+                .yes = yes
+            };
+        }
+
+        str = *end ? end + 1 : end;
+    }
+
+    return size;
+}
+
+void app_callback_query(app_data_t* adata)
+{
+    printf_and_say("Enter attributes, such as \"teaches physics, not lector\": ");
+
+    utils_str_t str = { NULL, 0 };
+    input_string_until_correct(&str.str, &str.len);
+
+    fact_tree_attr_t* attrs = TYPED_CALLOC(app_count_attrs(str.str), fact_tree_attr_t);
+    fact_tree_query_t query = {};
+
+    BEGIN {
+
+        if(!attrs) {
+            UTILS_LOGE(LOG_CATEGORY_APP, "%s", fact_tree_strerr(FACT_TREE_ALLOC_FAIL));
+            GOTO_END;
+        }
+
+        size_t attrs_size = app_parse_attrs(str.str, attrs);
+
+        fact_tree_err_t err = fact_tree_query(adata->ftree, &query, attrs, attrs_size);
+        if(err != FACT_TREE_ERR_NONE) {
+            UTILS_LOGE(LOG_CATEGORY_APP, "%s", fact_tree_strerr(err));
+            printf_and_say("%s\n", fact_tree_strerr(err));
+            GOTO_END;
+        }
+
+        size_t count = fact_tree_query_count(&query);
+
+        if(!count) {
+            printf_and_say("No such objects found\n");
+            GOTO_END;
+        }
+
+        printf_and_say("Found %zu objects:\n", count);
+
+        // names are only printed, saying every one of them takes long
+        for(const fact_tree_node_t* node = fact_tree_query_next(&query); node; node = fact_tree_query_next(&query))
+            printf("%.*s\n", (int) node->name_len, fact_tree_node_name(node));
+
+    } END;
+
+    fact_tree_query_end(&query);
+
+    NFREE(attrs);
+    NFREE(str.str);
+
+    printf_and_say("Press any key to continue...");
+    scanf("%*c");
+
+    adata->state = APP_STATE_MENU;
+}
+
+#undef ATTR_SEPARATOR
+#undef ATTR_NEGATION
+
 void app_callback_exit(app_data_t* adata)
 {
     adata->exit = 1;
 }
 
+int app_convert(fact_tree_t* ftree)
+{
+    fact_tree_err_t err = FACT_TREE_ERR_NONE;
+
+    if(long_opts[APP_OPT_TO_BIN].is_set)
+        err = fact_tree_fwrite_bin(ftree, long_opts[APP_OPT_TO_BIN].arg);
+
+    if(err == FACT_TREE_ERR_NONE && long_opts[APP_OPT_TO_TEXT].is_set)
+        err = fact_tree_fwrite(ftree, long_opts[APP_OPT_TO_TEXT].arg);
+
+    if(err == FACT_TREE_ERR_NONE && long_opts[APP_OPT_TO_PAGES].is_set)
+        err = fact_tree_fwrite_pages(ftree, long_opts[APP_OPT_TO_PAGES].arg);
+
+    if(err == FACT_TREE_ERR_NONE && long_opts[APP_OPT_PUBLISH].is_set)
+        err = fact_tree_publish(ftree, long_opts[APP_OPT_PUBLISH].arg);
+
+    if(err == FACT_TREE_ERR_NONE && long_opts[APP_OPT_TO_CPP].is_set)
+        err = fact_tree_fwrite_cpp(ftree, long_opts[APP_OPT_TO_CPP].arg);
+
+    if(err != FACT_TREE_ERR_NONE) {
+        UTILS_LOGE(LOG_CATEGORY_APP, "%s", fact_tree_strerr(err));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+fact_tree_err_t app_fread(fact_tree_t* ftree, const char* filename)
+{
+    // paged databases are told by their magic and opened by
+    // fact_tree_fread as well, --pool-size only overrides the
+    // memory cap of the buffer pool and leaves other files alone
+    if(long_opts[APP_OPT_POOL_SIZE].is_set) {
+        size_t pool_mb = strtoul(long_opts[APP_OPT_POOL_SIZE].arg, NULL, 10);
+        ftree->pages_pool = pool_mb << 20;
+    }
+
+    // processes started with --shared map one binary database
+    // and pick up every version published with --publish
+    if(long_opts[APP_OPT_SHARED].is_set)
+        return fact_tree_fread_shared(ftree, filename);
+
+    // guess sessions only walk one path, so with --lazy
+    // the rest of a huge database is never built
+    if(long_opts[APP_OPT_LAZY].is_set)
+        return fact_tree_fread_lazy(ftree, filename);
+
+    return fact_tree_fread(ftree, filename);
+}
+
 void clear_screen()
 {
     printf("\033[2J\033[H");
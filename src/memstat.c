@@ -0,0 +1,129 @@
+#include "memstat.h"
+
+#include <sys/resource.h>
+
+#include "assertutils.h"
+
+static memstat_counter_t memstat_counters_[MEMSTAT_KIND_COUNT] = {};
+static memstat_counter_t memstat_total_ = {};
+
+static void memstat_raise_peak_(size_t* peak, size_t bytes)
+{
+    size_t seen = __atomic_load_n(peak, __ATOMIC_RELAXED);
+
+    while(seen < bytes
+          && !__atomic_compare_exchange_n(peak, &seen, bytes, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static void memstat_add_(memstat_counter_t* counter, size_t bytes)
+{
+    __atomic_add_fetch(&counter->allocs, 1, __ATOMIC_RELAXED);
+
+    size_t now = __atomic_add_fetch(&counter->bytes, bytes, __ATOMIC_RELAXED);
+    memstat_raise_peak_(&counter->peak, now);
+}
+
+static void memstat_sub_(memstat_counter_t* counter, size_t bytes)
+{
+    __atomic_add_fetch(&counter->frees, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&counter->bytes, bytes, __ATOMIC_RELAXED);
+}
+
+void memstat_alloc(memstat_kind_t kind, size_t bytes)
+{
+    memstat_add_(&memstat_counters_[kind], bytes);
+    memstat_add_(&memstat_total_, bytes);
+}
+
+void memstat_free(memstat_kind_t kind, size_t bytes)
+{
+    memstat_sub_(&memstat_counters_[kind], bytes);
+    memstat_sub_(&memstat_total_, bytes);
+}
+
+static memstat_counter_t memstat_load_(const memstat_counter_t* counter)
+{
+    return {
+        .allocs = __atomic_load_n(&counter->allocs, __ATOMIC_RELAXED),
+        .frees  = __atomic_load_n(&counter->frees,  __ATOMIC_RELAXED),
+        .bytes  = __atomic_load_n(&counter->bytes,  __ATOMIC_RELAXED),
+        .peak   = __atomic_load_n(&counter->peak,   __ATOMIC_RELAXED)
+    };
+}
+
+memstat_counter_t memstat_get(memstat_kind_t kind)
+{
+    return memstat_load_(&memstat_counters_[kind]);
+}
+
+memstat_counter_t memstat_total()
+{
+    return memstat_load_(&memstat_total_);
+}
+
+const char* memstat_name(memstat_kind_t kind)
+{
+    switch(kind)
+    {
+        case MEMSTAT_NODES:
+            return "nodes";
+        case MEMSTAT_NAMES:
+            return "names";
+        case MEMSTAT_FILE:
+            return "file buffer";
+        case MEMSTAT_INDEX:
+            return "index";
+        case MEMSTAT_PAGES:
+            return "page pool";
+        case MEMSTAT_STACKS:
+            return "path stacks";
+        case MEMSTAT_WRITE:
+            return "write buffers";
+        case MEMSTAT_DEFS:
+            return "definitions";
+        case MEMSTAT_FESTIVAL:
+            return "festival";
+        case MEMSTAT_KIND_COUNT:
+        default:
+            return "unknown";
+    }
+}
+
+#define KIB_ 1024.0
+
+static void memstat_print_row_(FILE* stream, const char* name, const memstat_counter_t* counter)
+{
+    fprintf(
+        stream,
+        "%-14s %12.1f %12.1f %10zu %10zu\n",
+        name,
+        (double) counter->bytes / KIB_,
+        (double) counter->peak / KIB_,
+        counter->allocs,
+        counter->frees
+    );
+}
+
+void memstat_print(FILE* stream)
+{
+    utils_assert(stream);
+
+    fprintf(stream, "%-14s %12s %12s %10s %10s\n", "memory", "now, KiB", "peak, KiB", "allocs", "frees");
+
+    for(size_t i = 0; i < MEMSTAT_KIND_COUNT; ++i) {
+        memstat_counter_t counter = memstat_get((memstat_kind_t) i);
+        memstat_print_row_(stream, memstat_name((memstat_kind_t) i), &counter);
+    }
+
+    memstat_counter_t total = memstat_total();
+    memstat_print_row_(stream, "total", &total);
+
+    // everything the process touched, libraries included,
+    // ru_maxrss is in kilobytes on Linux
+    struct rusage usage = {};
+    if(getrusage(RUSAGE_SELF, &usage) == 0)
+        fprintf(stream, "%-14s %12s %12.1f\n", "peak rss", "", (double) usage.ru_maxrss);
+}
+
+#undef KIB_
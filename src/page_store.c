@@ -0,0 +1,409 @@
+#include "page_store.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "memstat.h"
+#include "wbuf.h"
+
+#define PAGE_STORE_NONE_ SIZE_MAX
+
+#define PAGE_STORE_TMP_SUFFIX_ ".XXXXXX"
+#define PAGE_STORE_FILE_MODE_ 0644
+
+// frames that failed to load are parked under a page number
+// that no lookup can ask for, until LRU reuses them
+#define PAGE_STORE_BAD_PAGE_ UINT64_MAX
+
+static size_t page_store_bytes_(const page_store_t* store)
+{
+    return store->frames_capacity * (PAGE_STORE_PAGE_SIZE + sizeof(store->frames[0]))
+         + store->buckets_size * sizeof(store->buckets[0]);
+}
+
+static size_t page_store_bucket_(const page_store_t* store, uint64_t page)
+{
+    return (size_t)((page * 0x9E3779B97F4A7C15ull) >> 32) % store->buckets_size;
+}
+
+static size_t page_store_lookup_(const page_store_t* store, uint64_t page)
+{
+    size_t frame = store->buckets[page_store_bucket_(store, page)];
+
+    while(frame != PAGE_STORE_NONE_ && store->frames[frame].page != page)
+        frame = store->frames[frame].hash_next;
+
+    return frame;
+}
+
+static void page_store_hash_insert_(page_store_t* store, size_t frame)
+{
+    size_t* bucket = &store->buckets[page_store_bucket_(store, store->frames[frame].page)];
+
+    store->frames[frame].hash_next = *bucket;
+    *bucket = frame;
+}
+
+static void page_store_hash_remove_(page_store_t* store, size_t frame)
+{
+    size_t* link = &store->buckets[page_store_bucket_(store, store->frames[frame].page)];
+
+    while(*link != PAGE_STORE_NONE_ && *link != frame)
+        link = &store->frames[*link].hash_next;
+
+    if(*link == frame)
+        *link = store->frames[frame].hash_next;
+}
+
+static void page_store_lru_unlink_(page_store_t* store, size_t frame)
+{
+    page_store_frame_t* fr = &store->frames[frame];
+
+    if(fr->lru_prev != PAGE_STORE_NONE_)
+        store->frames[fr->lru_prev].lru_next = fr->lru_next;
+    else
+        store->lru_head = fr->lru_next;
+
+    if(fr->lru_next != PAGE_STORE_NONE_)
+        store->frames[fr->lru_next].lru_prev = fr->lru_prev;
+    else
+        store->lru_tail = fr->lru_prev;
+}
+
+static void page_store_lru_push_front_(page_store_t* store, size_t frame)
+{
+    page_store_frame_t* fr = &store->frames[frame];
+
+    fr->lru_prev = PAGE_STORE_NONE_;
+    fr->lru_next = store->lru_head;
+
+    if(store->lru_head != PAGE_STORE_NONE_)
+        store->frames[store->lru_head].lru_prev = frame;
+    else
+        store->lru_tail = frame;
+
+    store->lru_head = frame;
+}
+
+static char* page_store_frame_data_(const page_store_t* store, size_t frame)
+{
+    return store->data + frame * PAGE_STORE_PAGE_SIZE;
+}
+
+static page_store_err_t page_store_writeback_(page_store_t* store, size_t frame)
+{
+    page_store_frame_t* fr = &store->frames[frame];
+
+    ssize_t written = pwrite(
+        store->fd,
+        page_store_frame_data_(store, frame),
+        PAGE_STORE_PAGE_SIZE,
+        (off_t)(fr->page * PAGE_STORE_PAGE_SIZE)
+    );
+
+    if(written != PAGE_STORE_PAGE_SIZE)
+        return PAGE_STORE_IO_ERR;
+
+    fr->dirty = 0;
+    store->stats.writebacks++;
+
+    return PAGE_STORE_ERR_NONE;
+}
+
+// Finds a frame for page: a free one while the pool is not full,
+// else the least recently used one, written back first if dirty.
+// The frame comes back hashed under page and at the LRU head
+static page_store_err_t page_store_frame_for_(page_store_t* store, uint64_t page, size_t* frame)
+{
+    if(store->frames_size < store->frames_capacity) {
+        *frame = store->frames_size++;
+    }
+    else {
+        *frame = store->lru_tail;
+
+        if(store->frames[*frame].dirty) {
+            page_store_err_t err = page_store_writeback_(store, *frame);
+            if(err != PAGE_STORE_ERR_NONE)
+                return err;
+        }
+
+        page_store_hash_remove_(store, *frame);
+        page_store_lru_unlink_(store, *frame);
+
+        store->stats.evictions++;
+    }
+
+    store->frames[*frame].page  = page;
+    store->frames[*frame].dirty = 0;
+
+    page_store_hash_insert_(store, *frame);
+    page_store_lru_push_front_(store, *frame);
+
+    return PAGE_STORE_ERR_NONE;
+}
+
+// Closes the file, removes an uncommitted temporary one and frees the paths
+static void page_store_discard_(page_store_t* store)
+{
+    if(store->fd >= 0)
+        close(store->fd);
+
+    if(store->tmp_path && store->fd >= 0)
+        unlink(store->tmp_path);
+
+    free(store->path);
+    free(store->tmp_path);
+
+    store->path     = NULL;
+    store->tmp_path = NULL;
+    store->fd       = -1;
+}
+
+// Makes the temporary file a created store is written to, in the
+// directory of the target so that the rename does not cross filesystems
+static page_store_err_t page_store_create_(page_store_t* store, const char* filename)
+{
+    size_t path_len = strlen(filename);
+
+    store->path     = strdup(filename);
+    store->tmp_path = (char*) calloc(path_len + sizeof(PAGE_STORE_TMP_SUFFIX_), sizeof(char));
+
+    if(!store->path || !store->tmp_path) {
+        page_store_discard_(store);
+        return PAGE_STORE_ALLOC_FAIL;
+    }
+
+    memcpy(store->tmp_path, filename, path_len);
+    memcpy(store->tmp_path + path_len, PAGE_STORE_TMP_SUFFIX_, sizeof(PAGE_STORE_TMP_SUFFIX_));
+
+    store->fd = mkstemp(store->tmp_path);
+    if(store->fd < 0) {
+        page_store_discard_(store);
+        return PAGE_STORE_IO_ERR;
+    }
+
+    // mkstemp creates 0600 files, keep the mode of the file being replaced
+    struct stat target_stats = {};
+    mode_t mode = stat(filename, &target_stats) == 0 ? target_stats.st_mode & 07777 : PAGE_STORE_FILE_MODE_;
+    fchmod(store->fd, mode);
+
+    return PAGE_STORE_ERR_NONE;
+}
+
+page_store_err_t page_store_open(page_store_t* store, const char* filename, size_t pool_size, page_store_mode_t mode)
+{
+    memset(store, 0, sizeof(*store));
+    store->fd = -1;
+
+    store->readonly = mode == PAGE_STORE_READ;
+
+    if(mode == PAGE_STORE_CREATE) {
+        page_store_err_t err = page_store_create_(store, filename);
+        if(err != PAGE_STORE_ERR_NONE)
+            return err;
+    }
+    else {
+        store->fd = open(filename, mode == PAGE_STORE_READ ? O_RDONLY : O_RDWR);
+        if(store->fd < 0)
+            return PAGE_STORE_IO_ERR;
+    }
+
+    struct stat fstats = {};
+    if(fstat(store->fd, &fstats) < 0 || fstats.st_size % PAGE_STORE_PAGE_SIZE != 0) {
+        if(fstats.st_size % PAGE_STORE_PAGE_SIZE != 0)
+            errno = EINVAL;
+        page_store_discard_(store);
+        return PAGE_STORE_IO_ERR;
+    }
+
+    store->page_count = (uint64_t) fstats.st_size / PAGE_STORE_PAGE_SIZE;
+
+    store->frames_capacity = pool_size / PAGE_STORE_PAGE_SIZE;
+    if(store->frames_capacity < PAGE_STORE_MIN_FRAMES)
+        store->frames_capacity = PAGE_STORE_MIN_FRAMES;
+
+    store->buckets_size = store->frames_capacity * 2;
+
+    store->data    = (char*) calloc(store->frames_capacity, PAGE_STORE_PAGE_SIZE);
+    store->frames  = (page_store_frame_t*) calloc(store->frames_capacity, sizeof(store->frames[0]));
+    store->buckets = (size_t*) calloc(store->buckets_size, sizeof(store->buckets[0]));
+
+    if(!store->data || !store->frames || !store->buckets) {
+        page_store_discard_(store);
+        free(store->data);
+        free(store->frames);
+        free(store->buckets);
+        return PAGE_STORE_ALLOC_FAIL;
+    }
+
+    memstat_alloc(MEMSTAT_PAGES, page_store_bytes_(store));
+
+    for(size_t i = 0; i < store->buckets_size; ++i)
+        store->buckets[i] = PAGE_STORE_NONE_;
+
+    store->lru_head = PAGE_STORE_NONE_;
+    store->lru_tail = PAGE_STORE_NONE_;
+
+    return PAGE_STORE_ERR_NONE;
+}
+
+char* page_store_get(page_store_t* store, uint64_t page, int dirty)
+{
+    if(page >= store->page_count)
+        return NULL;
+
+    if(dirty && store->readonly) {
+        errno = EBADF;
+        return NULL;
+    }
+
+    size_t frame = page_store_lookup_(store, page);
+
+    if(frame != PAGE_STORE_NONE_) {
+        store->stats.hits++;
+
+        page_store_lru_unlink_(store, frame);
+        page_store_lru_push_front_(store, frame);
+    }
+    else {
+        store->stats.misses++;
+
+        if(page_store_frame_for_(store, page, &frame) != PAGE_STORE_ERR_NONE)
+            return NULL;
+
+        char* data = page_store_frame_data_(store, frame);
+
+        ssize_t nread = pread(store->fd, data, PAGE_STORE_PAGE_SIZE, (off_t)(page * PAGE_STORE_PAGE_SIZE));
+
+        // pages appended after the last flush may be missing on disk
+        if(nread < 0) {
+            page_store_hash_remove_(store, frame);
+            store->frames[frame].page = PAGE_STORE_BAD_PAGE_;
+            page_store_hash_insert_(store, frame);
+            return NULL;
+        }
+
+        memset(data + nread, 0, PAGE_STORE_PAGE_SIZE - (size_t) nread);
+    }
+
+    store->frames[frame].dirty |= dirty;
+
+    return page_store_frame_data_(store, frame);
+}
+
+page_store_err_t page_store_append(page_store_t* store, uint64_t* page)
+{
+    if(store->readonly) {
+        errno = EBADF;
+        return PAGE_STORE_IO_ERR;
+    }
+
+    size_t frame = PAGE_STORE_NONE_;
+
+    page_store_err_t err = page_store_frame_for_(store, store->page_count, &frame);
+    if(err != PAGE_STORE_ERR_NONE)
+        return err;
+
+    memset(page_store_frame_data_(store, frame), 0, PAGE_STORE_PAGE_SIZE);
+    store->frames[frame].dirty = 1;
+
+    *page = store->page_count++;
+
+    return PAGE_STORE_ERR_NONE;
+}
+
+page_store_err_t page_store_flush(page_store_t* store)
+{
+    if(store->readonly)
+        return PAGE_STORE_ERR_NONE;
+
+    for(size_t i = 0; i < store->frames_size; ++i) {
+        if(!store->frames[i].dirty)
+            continue;
+
+        page_store_err_t err = page_store_writeback_(store, i);
+        if(err != PAGE_STORE_ERR_NONE)
+            return err;
+    }
+
+    return fsync(store->fd) == 0 ? PAGE_STORE_ERR_NONE : PAGE_STORE_IO_ERR;
+}
+
+static void page_store_free_(page_store_t* store)
+{
+    memstat_free(MEMSTAT_PAGES, page_store_bytes_(store));
+
+    free(store->data);
+    free(store->frames);
+    free(store->buckets);
+
+    store->data    = NULL;
+    store->frames  = NULL;
+    store->buckets = NULL;
+    store->fd      = -1;
+}
+
+page_store_err_t page_store_close(page_store_t* store)
+{
+    page_store_err_t err = PAGE_STORE_ERR_NONE;
+
+    // an uncommitted new file is thrown away, there is nothing to flush it for
+    if(store->tmp_path) {
+        page_store_discard_(store);
+    }
+    else {
+        err = page_store_flush(store);
+
+        if(close(store->fd) != 0 && err == PAGE_STORE_ERR_NONE)
+            err = PAGE_STORE_IO_ERR;
+    }
+
+    page_store_free_(store);
+
+    return err;
+}
+
+page_store_err_t page_store_commit(page_store_t* store)
+{
+    page_store_err_t err = page_store_flush(store);
+
+    if(close(store->fd) != 0 && err == PAGE_STORE_ERR_NONE)
+        err = PAGE_STORE_IO_ERR;
+
+    store->fd = -1;
+
+    if(err == PAGE_STORE_ERR_NONE && rename(store->tmp_path, store->path) != 0)
+        err = PAGE_STORE_IO_ERR;
+
+    if(err == PAGE_STORE_ERR_NONE && wbuf_fsync_dir(store->path) != WBUF_ERR_NONE)
+        err = PAGE_STORE_IO_ERR;
+    else if(err != PAGE_STORE_ERR_NONE)
+        unlink(store->tmp_path);
+
+    page_store_discard_(store);
+    page_store_free_(store);
+
+    return err;
+}
+
+const char* page_store_strerr(page_store_err_t err)
+{
+    switch(err) {
+        case PAGE_STORE_ERR_NONE:
+            return "none";
+        case PAGE_STORE_IO_ERR:
+            return "io error";
+        case PAGE_STORE_ALLOC_FAIL:
+            return "memory allocation failed";
+        default:
+            return "unknown";
+    }
+}
+
+#undef PAGE_STORE_NONE_
+#undef PAGE_STORE_TMP_SUFFIX_
+#undef PAGE_STORE_FILE_MODE_
+#undef PAGE_STORE_BAD_PAGE_
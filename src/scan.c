@@ -0,0 +1,272 @@
+#include "scan.h"
+
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define NIL_STR_ "nil"
+
+// Both scanners below go wide only while a whole vector fits before len:
+// the buffer is usually an mmap'ed file, so reading past its end may fault.
+
+static inline int scan_is_space_(char chr)
+{
+    return chr == ' ' || (unsigned char)(chr - '\t') <= (unsigned char)('\r' - '\t');
+}
+
+#if defined(__AVX2__)
+
+static inline unsigned scan_space_mask_avx2_(const char* ptr)
+{
+    const __m256i chunk = _mm256_loadu_si256((const __m256i*) ptr);
+
+    // \t..\r are contiguous: c - '\t' <= '\r' - '\t' as unsigned bytes
+    const __m256i shifted = _mm256_sub_epi8(chunk, _mm256_set1_epi8('\t'));
+    const __m256i ctrl    = _mm256_cmpeq_epi8(
+        _mm256_min_epu8(shifted, _mm256_set1_epi8('\r' - '\t')), 
+        shifted
+    );
+    const __m256i space   = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' '));
+
+    return (unsigned) _mm256_movemask_epi8(_mm256_or_si256(ctrl, space));
+}
+
+#endif // __AVX2__
+
+#if defined(__SSE2__)
+
+static inline unsigned scan_space_mask_sse2_(const char* ptr)
+{
+    const __m128i chunk = _mm_loadu_si128((const __m128i*) ptr);
+
+    const __m128i shifted = _mm_sub_epi8(chunk, _mm_set1_epi8('\t'));
+    const __m128i ctrl    = _mm_cmpeq_epi8(
+        _mm_min_epu8(shifted, _mm_set1_epi8('\r' - '\t')), 
+        shifted
+    );
+    const __m128i space   = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+
+    return (unsigned) _mm_movemask_epi8(_mm_or_si128(ctrl, space));
+}
+
+#endif // __SSE2__
+
+size_t scan_skip_spaces(const char* buf, size_t len, size_t pos)
+{
+    // tokens are mostly separated by a single space,
+    // so check two bytes before setting up vector registers
+    for(int i = 0; i < 2; ++i, ++pos)
+        if(pos >= len || !scan_is_space_(buf[pos]))
+            return pos < len ? pos : len;
+
+#if defined(__AVX2__)
+    for( ; pos + sizeof(__m256i) <= len; pos += sizeof(__m256i)) {
+        unsigned not_space = ~scan_space_mask_avx2_(buf + pos);
+        if(not_space)
+            return pos + (size_t) __builtin_ctz(not_space);
+    }
+#endif // __AVX2__
+
+#if defined(__SSE2__)
+    for( ; pos + sizeof(__m128i) <= len; pos += sizeof(__m128i)) {
+        unsigned not_space = ~scan_space_mask_sse2_(buf + pos) & 0xFFFFu;
+        if(not_space)
+            return pos + (size_t) __builtin_ctz(not_space);
+    }
+#endif // __SSE2__
+
+    while(pos < len && scan_is_space_(buf[pos]))
+        ++pos;
+
+    return pos;
+}
+
+size_t scan_find_char(const char* buf, size_t len, size_t pos, char chr)
+{
+#if defined(__AVX2__)
+    const __m256i pattern256 = _mm256_set1_epi8(chr);
+
+    for( ; pos + sizeof(__m256i) <= len; pos += sizeof(__m256i)) {
+        const __m256i chunk = _mm256_loadu_si256((const __m256i*)(buf + pos));
+        unsigned found = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, pattern256));
+        if(found)
+            return pos + (size_t) __builtin_ctz(found);
+    }
+#endif // __AVX2__
+
+#if defined(__SSE2__)
+    const __m128i pattern128 = _mm_set1_epi8(chr);
+
+    for( ; pos + sizeof(__m128i) <= len; pos += sizeof(__m128i)) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)(buf + pos));
+        unsigned found = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern128));
+        if(found)
+            return pos + (size_t) __builtin_ctz(found);
+    }
+#endif // __SSE2__
+
+    while(pos < len && buf[pos] != chr)
+        ++pos;
+
+    return pos;
+}
+
+scan_token_t scan_next_token(const char* buf, size_t len, size_t pos)
+{
+    pos = scan_skip_spaces(buf, len, pos);
+
+    scan_token_t tok = { .kind = SCAN_TOKEN_END, .pos = pos, .len = 0 };
+
+    if(pos == len)
+        return tok;
+
+    switch(buf[pos]) {
+        case '(':
+            tok.kind = SCAN_TOKEN_OPEN;
+            tok.len  = 1;
+            break;
+        case ')':
+            tok.kind = SCAN_TOKEN_CLOSE;
+            tok.len  = 1;
+            break;
+        case '"': {
+            size_t end = scan_find_char(buf, len, pos + 1, '"');
+            if(end == len) {
+                // unterminated string, report at the end of input
+                tok.kind = SCAN_TOKEN_INVALID;
+                tok.pos  = len;
+                break;
+            }
+            tok.kind = SCAN_TOKEN_STRING;
+            tok.len  = end - pos + 1;
+            break;
+        }
+        case 'n':
+            if(len - pos >= sizeof(NIL_STR_) - 1 
+                    && memcmp(buf + pos, NIL_STR_, sizeof(NIL_STR_) - 1) == 0) {
+                tok.kind = SCAN_TOKEN_NIL;
+                tok.len  = sizeof(NIL_STR_) - 1;
+                break;
+            }
+            tok.kind = SCAN_TOKEN_INVALID;
+            break;
+        default:
+            tok.kind = SCAN_TOKEN_INVALID;
+            break;
+    }
+
+    return tok;
+}
+
+#define SCAN_BLOCK_SIZE_ 64
+
+static inline uint64_t scan_block_mask_(const char* ptr, char chr)
+{
+#if defined(__AVX2__)
+    const __m256i pattern = _mm256_set1_epi8(chr);
+
+    uint64_t lo = (uint32_t) _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) ptr), pattern));
+    uint64_t hi = (uint32_t) _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(ptr + 32)), pattern));
+
+    return lo | hi << 32;
+#elif defined(__SSE2__)
+    const __m128i pattern = _mm_set1_epi8(chr);
+
+    uint64_t mask = 0;
+    for(int i = 0; i < 4; ++i) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)(ptr + 16 * i));
+        mask |= (uint64_t)(uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern)) << (16 * i);
+    }
+
+    return mask;
+#else
+    uint64_t mask = 0;
+    for(int i = 0; i < SCAN_BLOCK_SIZE_; ++i)
+        mask |= (uint64_t)(ptr[i] == chr) << i;
+
+    return mask;
+#endif
+}
+
+// Bit i of the result is the xor of bits 0..i, i.e. set
+// for every byte between an opening quote and its closing one
+static inline uint64_t scan_prefix_xor_(uint64_t mask)
+{
+    mask ^= mask << 1;
+    mask ^= mask << 2;
+    mask ^= mask << 4;
+    mask ^= mask << 8;
+    mask ^= mask << 16;
+    mask ^= mask << 32;
+
+    return mask;
+}
+
+static int scan_index_reserve_(scan_index_t* index, size_t size)
+{
+    if(size <= index->capacity)
+        return 0;
+
+    size_t capacity_new = index->capacity ? index->capacity : SCAN_BLOCK_SIZE_;
+    while(capacity_new < size)
+        capacity_new *= 2;
+
+    size_t* offs_new = (size_t*) realloc(index->offs, capacity_new * sizeof(offs_new[0]));
+    if(!offs_new)
+        return -1;
+
+    index->offs     = offs_new;
+    index->capacity = capacity_new;
+
+    return 0;
+}
+
+int scan_build_index(const char* buf, size_t len, scan_index_t* index)
+{
+    index->size = 0;
+
+    // all ones when the previous block ended inside a quoted name
+    uint64_t in_string_carry = 0;
+
+    for(size_t pos = 0; pos < len; pos += SCAN_BLOCK_SIZE_) {
+        const char* block = buf + pos;
+
+        // same as for the scanners above: never load past len
+        char tail[SCAN_BLOCK_SIZE_];
+        if(len - pos < SCAN_BLOCK_SIZE_) {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, block, len - pos);
+            block = tail;
+        }
+
+        uint64_t in_string = scan_prefix_xor_(scan_block_mask_(block, '"')) ^ in_string_carry;
+        in_string_carry = (uint64_t)((int64_t) in_string >> 63);
+
+        uint64_t parens = (scan_block_mask_(block, '(') | scan_block_mask_(block, ')')) & ~in_string;
+
+        if(scan_index_reserve_(index, index->size + (size_t) __builtin_popcountll(parens)) != 0)
+            return -1;
+
+        for( ; parens; parens &= parens - 1)
+            index->offs[index->size++] = pos + (size_t) __builtin_ctzll(parens);
+    }
+
+    return 0;
+}
+
+void scan_index_dtor(scan_index_t* index)
+{
+    free(index->offs);
+
+    index->offs     = NULL;
+    index->size     = 0;
+    index->capacity = 0;
+}
+
+#undef SCAN_BLOCK_SIZE_
+
+#undef NIL_STR_
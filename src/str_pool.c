@@ -0,0 +1,181 @@
+#include "str_pool.h"
+
+#include <string.h>
+
+#include "memstat.h"
+
+#define FNV_OFFSET_ 2166136261u
+#define FNV_PRIME_  16777619u
+
+static uint32_t str_pool_hash_(const char* str, size_t len)
+{
+    uint32_t hash = FNV_OFFSET_;
+
+    for(size_t i = 0; i < len; ++i) {
+        hash ^= (unsigned char) str[i];
+        hash *= FNV_PRIME_;
+    }
+
+    return hash;
+}
+
+// Returns the slot holding str or the free slot where it belongs
+static size_t str_pool_slot_(const str_pool_t* pool, const char* str, size_t len, uint32_t hash)
+{
+    size_t mask = pool->table_size - 1;
+    size_t slot = hash & mask;
+
+    while(pool->table[slot] != STR_POOL_NONE) {
+        uint32_t id = pool->table[slot];
+
+        if(pool->hashes[id] == hash
+                && pool->strs[id].len == len
+                && memcmp(pool->strs[id].str, str, len) == 0)
+            break;
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+// Keeps the table at most half full
+static int str_pool_rehash_(str_pool_t* pool)
+{
+    size_t table_size = pool->table_size ? pool->table_size * 2 : STR_POOL_INIT_CAPACITY * 2;
+
+    uint32_t* table = (uint32_t*) calloc(table_size, sizeof(table[0]));
+    if(!table)
+        return 0;
+
+    memstat_resize(MEMSTAT_NAMES, pool->table_size * sizeof(table[0]), table_size * sizeof(table[0]));
+
+    free(pool->table);
+
+    pool->table      = table;
+    pool->table_size = table_size;
+
+    for(uint32_t id = 1; id < pool->size; ++id) {
+        size_t slot = pool->hashes[id] & (table_size - 1);
+
+        while(table[slot] != STR_POOL_NONE)
+            slot = (slot + 1) & (table_size - 1);
+
+        table[slot] = id;
+    }
+
+    return 1;
+}
+
+static int str_pool_reserve_(str_pool_t* pool)
+{
+    if(pool->size < pool->capacity)
+        return 1;
+
+    size_t capacity = pool->capacity ? pool->capacity * 2 : STR_POOL_INIT_CAPACITY;
+
+    utils_str_t* strs = (utils_str_t*) realloc(pool->strs, capacity * sizeof(strs[0]));
+    if(!strs)
+        return 0;
+    pool->strs = strs;
+
+    memstat_resize(MEMSTAT_NAMES, pool->capacity * sizeof(strs[0]), capacity * sizeof(strs[0]));
+
+    uint32_t* hashes = (uint32_t*) realloc(pool->hashes, capacity * sizeof(hashes[0]));
+    if(!hashes)
+        return 0;
+    pool->hashes = hashes;
+
+    memstat_resize(MEMSTAT_NAMES, pool->capacity * sizeof(hashes[0]), capacity * sizeof(hashes[0]));
+
+    pool->capacity = capacity;
+
+    // entry 0 stands for STR_POOL_NONE
+    if(pool->size == 0) {
+        pool->strs[0]   = UTILS_STR_INITLIST;
+        pool->hashes[0] = 0;
+        pool->size      = 1;
+    }
+
+    return 1;
+}
+
+void str_pool_dtor(str_pool_t* pool)
+{
+    size_t bytes = pool->capacity * (sizeof(pool->strs[0]) + sizeof(pool->hashes[0]))
+                 + pool->table_size * sizeof(pool->table[0]);
+
+    if(bytes)
+        memstat_free(MEMSTAT_NAMES, bytes);
+
+    free(pool->strs);
+    free(pool->hashes);
+    free(pool->table);
+
+    pool->strs       = NULL;
+    pool->hashes     = NULL;
+    pool->table      = NULL;
+    pool->size       = 0;
+    pool->capacity   = 0;
+    pool->table_size = 0;
+    pool->stats      = {};
+}
+
+uint32_t str_pool_find(const str_pool_t* pool, const char* str, size_t len)
+{
+    if(!pool->table_size)
+        return STR_POOL_NONE;
+
+    return pool->table[str_pool_slot_(pool, str, len, str_pool_hash_(str, len))];
+}
+
+// With arena set a new string is copied there before it is added
+static uint32_t str_pool_intern_(str_pool_t* pool, const char* str, size_t len, char* borrowed, arena_t* arena)
+{
+    uint32_t hash = str_pool_hash_(str, len);
+
+    if(pool->table_size) {
+        uint32_t id = pool->table[str_pool_slot_(pool, str, len, hash)];
+
+        if(id != STR_POOL_NONE) {
+            pool->stats.shared++;
+            pool->stats.shared_bytes += len;
+            return id;
+        }
+    }
+
+    if(!str_pool_reserve_(pool) || pool->size >= UINT32_MAX)
+        return STR_POOL_NONE;
+
+    if(pool->size * 2 >= pool->table_size && !str_pool_rehash_(pool))
+        return STR_POOL_NONE;
+
+    char* stored = arena ? arena_strndup(arena, str, len) : borrowed;
+    if(!stored)
+        return STR_POOL_NONE;
+
+    uint32_t id = (uint32_t) pool->size++;
+
+    pool->strs[id].str = stored;
+    pool->strs[id].len = len;
+    pool->hashes[id]   = hash;
+
+    pool->table[str_pool_slot_(pool, str, len, hash)] = id;
+
+    pool->stats.interned++;
+
+    return id;
+}
+
+uint32_t str_pool_intern(str_pool_t* pool, char* str, size_t len)
+{
+    return str_pool_intern_(pool, str, len, str, NULL);
+}
+
+uint32_t str_pool_intern_copy(str_pool_t* pool, const char* str, size_t len, arena_t* arena)
+{
+    return str_pool_intern_(pool, str, len, NULL, arena);
+}
+
+#undef FNV_OFFSET_
+#undef FNV_PRIME_
@@ -0,0 +1,224 @@
+#include "wbuf.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "memstat.h"
+
+#define TMP_SUFFIX_ ".XXXXXX"
+#define NEW_FILE_MODE_ 0644
+
+static wbuf_err_t wbuf_write_all_(wbuf_t* wbuf, const char* data, size_t len)
+{
+    while(len) {
+        ssize_t written = write(wbuf->fd, data, len);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            return WBUF_IO_ERR;
+
+        data += written;
+        len  -= (size_t) written;
+        wbuf->written += (size_t) written;
+    }
+
+    return WBUF_ERR_NONE;
+}
+
+void wbuf_free(wbuf_t* wbuf)
+{
+    if(wbuf->data)
+        memstat_free(MEMSTAT_WRITE, wbuf->capacity);
+
+    free(wbuf->data);
+    free(wbuf->path);
+    free(wbuf->tmp_path);
+
+    wbuf->data     = NULL;
+    wbuf->path     = NULL;
+    wbuf->tmp_path = NULL;
+    wbuf->fd       = -1;
+    wbuf->size     = 0;
+    wbuf->capacity = 0;
+}
+
+wbuf_err_t wbuf_open(wbuf_t* wbuf, const char* path)
+{
+    memset(wbuf, 0, sizeof(*wbuf));
+    wbuf->fd = -1;
+
+    size_t path_len = strlen(path);
+
+    wbuf->path     = strdup(path);
+    wbuf->tmp_path = (char*) calloc(path_len + sizeof(TMP_SUFFIX_), sizeof(char));
+    wbuf->data     = (char*) malloc(WBUF_CAPACITY);
+    wbuf->capacity = WBUF_CAPACITY;
+
+    if(wbuf->data)
+        memstat_alloc(MEMSTAT_WRITE, WBUF_CAPACITY);
+
+    if(!wbuf->path || !wbuf->tmp_path || !wbuf->data) {
+        wbuf_free(wbuf);
+        return WBUF_ALLOC_FAIL;
+    }
+
+    // same directory as the target, so that rename does not cross filesystems
+    memcpy(wbuf->tmp_path, path, path_len);
+    memcpy(wbuf->tmp_path + path_len, TMP_SUFFIX_, sizeof(TMP_SUFFIX_));
+
+    wbuf->fd = mkstemp(wbuf->tmp_path);
+    if(wbuf->fd < 0) {
+        wbuf_free(wbuf);
+        return WBUF_IO_ERR;
+    }
+
+    // mkstemp creates 0600 files, keep the mode of the file being replaced
+    struct stat target_stats = {};
+    mode_t mode = stat(path, &target_stats) == 0 ? target_stats.st_mode & 07777 : NEW_FILE_MODE_;
+    fchmod(wbuf->fd, mode);
+
+    return WBUF_ERR_NONE;
+}
+
+wbuf_err_t wbuf_open_mem(wbuf_t* wbuf)
+{
+    memset(wbuf, 0, sizeof(*wbuf));
+    wbuf->fd = -1;
+
+    wbuf->data = (char*) malloc(WBUF_MEM_INIT_CAPACITY);
+    if(!wbuf->data)
+        return wbuf->err = WBUF_ALLOC_FAIL;
+
+    wbuf->capacity = WBUF_MEM_INIT_CAPACITY;
+
+    memstat_alloc(MEMSTAT_WRITE, WBUF_MEM_INIT_CAPACITY);
+
+    return WBUF_ERR_NONE;
+}
+
+static void wbuf_grow_(wbuf_t* wbuf, size_t needed)
+{
+    size_t capacity_new = wbuf->capacity ? wbuf->capacity : WBUF_MEM_INIT_CAPACITY;
+    while(capacity_new < needed)
+        capacity_new *= 2;
+
+    char* data_new = (char*) realloc(wbuf->data, capacity_new);
+    if(!data_new) {
+        wbuf->err = WBUF_ALLOC_FAIL;
+        return;
+    }
+
+    memstat_resize(MEMSTAT_WRITE, wbuf->capacity, capacity_new);
+
+    wbuf->data     = data_new;
+    wbuf->capacity = capacity_new;
+}
+
+wbuf_err_t wbuf_flush(wbuf_t* wbuf)
+{
+    // memory buffers have nowhere to flush to
+    if(wbuf->fd < 0)
+        return wbuf->err;
+
+    if(wbuf->err == WBUF_ERR_NONE && wbuf->size)
+        wbuf->err = wbuf_write_all_(wbuf, wbuf->data, wbuf->size);
+
+    wbuf->size = 0;
+
+    return wbuf->err;
+}
+
+void wbuf_put_slow(wbuf_t* wbuf, const void* data, size_t len)
+{
+    if(wbuf->err != WBUF_ERR_NONE)
+        return;
+
+    if(wbuf->fd < 0) {
+        wbuf_grow_(wbuf, wbuf->size + len);
+        if(wbuf->err != WBUF_ERR_NONE)
+            return;
+
+        memcpy(wbuf->data + wbuf->size, data, len);
+        wbuf->size += len;
+        return;
+    }
+
+    if(wbuf_flush(wbuf) != WBUF_ERR_NONE)
+        return;
+
+    if(len > WBUF_CAPACITY) {
+        wbuf->err = wbuf_write_all_(wbuf, (const char*) data, len);
+        return;
+    }
+
+    memcpy(wbuf->data, data, len);
+    wbuf->size = len;
+}
+
+wbuf_err_t wbuf_fsync_dir(const char* path)
+{
+    const char* slash = strrchr(path, '/');
+
+    char* dir = slash ? strndup(path, (size_t)(slash - path) + 1) : strdup(".");
+    if(!dir)
+        return WBUF_ALLOC_FAIL;
+
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+    free(dir);
+
+    if(dir_fd < 0)
+        return WBUF_IO_ERR;
+
+    int ok = fsync(dir_fd) == 0;
+    close(dir_fd);
+
+    return ok ? WBUF_ERR_NONE : WBUF_IO_ERR;
+}
+
+wbuf_err_t wbuf_commit(wbuf_t* wbuf)
+{
+    wbuf_err_t err = wbuf_flush(wbuf);
+
+    if(err == WBUF_ERR_NONE && fsync(wbuf->fd) != 0)
+        err = WBUF_IO_ERR;
+
+    if(close(wbuf->fd) != 0 && err == WBUF_ERR_NONE)
+        err = WBUF_IO_ERR;
+
+    wbuf->fd = -1;
+
+    if(err == WBUF_ERR_NONE && rename(wbuf->tmp_path, wbuf->path) != 0)
+        err = WBUF_IO_ERR;
+
+    // the rename itself is durable only once the directory is synced
+    if(err == WBUF_ERR_NONE)
+        err = wbuf_fsync_dir(wbuf->path);
+    else
+        unlink(wbuf->tmp_path);
+
+    wbuf->err = err;
+
+    wbuf_free(wbuf);
+
+    return err;
+}
+
+const char* wbuf_strerr(wbuf_err_t err)
+{
+    switch(err) {
+        case WBUF_ERR_NONE:
+            return "none";
+        case WBUF_IO_ERR:
+            return "io error";
+        case WBUF_ALLOC_FAIL:
+            return "memory allocation failed";
+        default:
+            return "unknown";
+    }
+}
+
+#undef TMP_SUFFIX_
+#undef NEW_FILE_MODE_